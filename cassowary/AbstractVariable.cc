@@ -25,30 +25,39 @@ long AbstractVariable::iVariableNumber = 0;
 AbstractVariable::AbstractVariable( string Name )
     : _flags(0)
     , _name( Name)
+    , _id( ATOMIC_ADD( &iVariableNumber, 1))
 #ifdef CL_PV
     , _pv( 0)
 #endif    
     { 
-    ++iVariableNumber;
     if ( Name.length() == 0)
       {
       char sz[16];
-      sprintf( sz,"v%ld",iVariableNumber);
+      sprintf( sz,"v%ld",_id);
       _name = string( sz);
       }
     }
 
 AbstractVariable::AbstractVariable( long varnumber, char * prefix) 
     : _flags(0)
+    , _id( ATOMIC_ADD( &iVariableNumber, 1))
 #ifdef CL_PV
     , _pv( 0)
 #endif    
     {
-    iVariableNumber++;
     char pch[16]; sprintf( pch,"%ld",varnumber);
     _name = string( prefix ) + string( pch);
     }
 
+AbstractVariable::AbstractVariable( const AbstractVariable & clv)
+    : _flags( clv._flags)
+    , _name( clv._name)
+    , _id( ATOMIC_ADD( &iVariableNumber, 1))
+#ifdef CL_PV
+    , _pv( clv._pv)
+#endif    
+    { }
+
 AbstractVariable::~AbstractVariable() {
 //    REFCOUNT_DIE( AbstractVariable)
 }
@@ -37,6 +37,8 @@ protected:
 public:
   AbstractVariable( string Name = "");
   AbstractVariable( long varnumber, char * prefix);
+  // ( a copy is a new variable, with a serial number of its own)
+  AbstractVariable( const AbstractVariable & clv);
   virtual ~AbstractVariable();
   /*struct Flags {
     bool IsFloatVariable :1;
@@ -52,6 +54,14 @@ public:
   // Set the Name of the variable
   virtual void SetName( const string & Name) { _name = Name; }
 
+  // Return the serial number of the variable.  Variables are numbered
+  // from 1 in the order they are made, and ordered by number rather
+  // than by address, so that the solver's maps and sets, and so the
+  // pivots it chooses, are the same from one run to the next.  The
+  // newest come first, which puts the variables a change has just
+  // made ahead in the pivoting rules' scans.
+  long Id() const { return _id; }
+
   // Return true iff this variable is a FloatVariable
   bool IsFloatVariable() const { return _flags & E_IsFloatVariable; }
 
@@ -93,7 +103,7 @@ public:
 #endif // CL_NO_IO
 
   friend bool operator<( const AbstractVariable & cl1, const AbstractVariable & cl2)
-    { return & cl1 < & cl2; }
+    { return cl1._id > cl2._id; }
 
   bool operator == ( const AbstractVariable & cl2) const { return this == &cl2; } 
   bool operator != ( const AbstractVariable & cl2) const { return this != &cl2; }
@@ -110,6 +120,7 @@ public:
 
 private:
   string _name;
+  const long _id;
 
   static long iVariableNumber;
 
@@ -37,7 +37,7 @@
 #include "cassowary/Errors.h"
 #include "cassowary/EditConstraint.h"
 #include "cassowary/StayConstraint.h"
-//#include "cassowary/Reader.h"
+#include "cassowary/Reader.h"
 #include "cassowary/Constraint.h"
 #if defined( CL_HAVE_GTL) && defined( CL_BUILD_FD_SOLVER)
 #include "cassowary/FDBinaryOneWayConstraint.h"
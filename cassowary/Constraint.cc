@@ -26,12 +26,26 @@ void decref( Constraint * p, int del)  {
     p->decref(); if (del && !p->nref()) delete p; }
 */
 
+long Constraint::iConstraintNumber = 0;
+
 Constraint::Constraint( const Strength & strength, double weight ) :
     _strength( strength),
     _readOnlyVars(),
     _weight( weight),
     _pv( 0),
-    _times_added( 0)
+    _times_added( 0),
+    _id( ATOMIC_ADD( &iConstraintNumber, 1))
+{ 
+    CtrTracer( __FUNCTION__,this);
+}
+
+Constraint::Constraint( const Constraint & cn) :
+    _strength( cn._strength),
+    _readOnlyVars( cn._readOnlyVars),
+    _weight( cn._weight),
+    _pv( cn._pv),
+    _times_added( 0),
+    _id( ATOMIC_ADD( &iConstraintNumber, 1))
 { 
     CtrTracer( __FUNCTION__,this);
 }
@@ -40,6 +54,78 @@ Constraint::~Constraint()
     REFCOUNT_DIE( Constraint)
     DtrTracer( __FUNCTION__,this);
 }
+
+bool
+operator<( const P_Constraint & pcn1, const P_Constraint & pcn2)
+{
+  return ( pcn1? pcn1->Id() : 0) < ( pcn2? pcn2->Id() : 0);
+}
+
+// Fold the bytes of an object into a running FNV-1a hash
+static size_t
+HashBytes( size_t h, const void * pv, size_t cb)
+{
+  const unsigned char * pb = static_cast<const unsigned char * >( pv);
+  for ( size_t i = 0; i < cb; ++i)
+    {
+    h ^= pb[i];
+    h *= 16777619;
+    }
+  return h;
+}
+
+static size_t
+HashNumber( size_t h, double n)
+{
+  // +0.0 and -0.0 should hash alike, as they compare equal
+  if ( n == 0.0)
+    n = 0.0;
+  return HashBytes( h, &n, sizeof( n));
+}
+
+size_t
+Constraint::StructuralHash() const
+{
+  size_t h = 2166136261u;
+  int kind = ( IsEditConstraint()? 1 : 0) | ( isStayConstraint()? 2 : 0) |
+    ( IsInequality()? 4 : 0) | ( IsStrictInequality()? 8 : 0) | 
+    ( IsRequired()? 16 : 0);
+  h = HashBytes( h, &kind, sizeof( kind));
+  h = HashNumber( h, weight());
+  h = HashNumber( h, symbolicWeight().AsDouble());
+
+  LinearExpression expr = Expression();
+  h = HashNumber( h, expr.Constant());
+  const VarToNumberMap & terms = expr.Terms();
+  for ( VarToNumberMap::const_iterator it = terms.begin(); 
+        it != terms.end(); ++it)
+    {
+    long id = (*it).first.Id();
+    h = HashBytes( h, &id, sizeof( id));
+    h = HashNumber( h, (*it).second);
+    }
+  return h;
+}
+
+bool
+Constraint::FIsStructurallyEqual( const Constraint & cn) const
+{
+  if ( this == &cn)
+    return true;
+  if ( IsEditConstraint() != cn.IsEditConstraint() ||
+       isStayConstraint() != cn.isStayConstraint() ||
+       IsInequality() != cn.IsInequality() ||
+       IsStrictInequality() != cn.IsStrictInequality() ||
+       IsRequired() != cn.IsRequired() ||
+       weight() != cn.weight() ||
+       symbolicWeight() != cn.symbolicWeight() ||
+       _readOnlyVars != cn._readOnlyVars)
+    return false;
+  LinearExpression expr = Expression();
+  LinearExpression exprOther = cn.Expression();
+  return ( expr.Constant() == exprOther.Constant() && 
+           expr.Terms() == exprOther.Terms());
+}
     
 #ifndef CL_NO_IO
 #include "Tableau.h" // for VarSet printing
@@ -49,8 +135,10 @@ Constraint::PrintOn( ostream & xo) const
 {
   // Note that the trailing "= 0)" or ">= 0)" is missing, as derived classes will
   // print the right thing after calling this function
+  // _times_added may be changing in another thread ( see
+  // SimplexSolver::SolveScenarios), so read it atomically
   xo << strength() << " w{" << weight() << "} ta{" 
-     << _times_added << "} RO" << _readOnlyVars << " " << "(" << Expression();
+     << ATOMIC_ADD( const_cast<int *>( &_times_added), 0) << "} RO" << _readOnlyVars << " " << "(" << Expression();
   return xo;
 }
 
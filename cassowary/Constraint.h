@@ -64,8 +64,16 @@ class Constraint {
 public:
 
   Constraint( const Strength & strength = sRequired(), double weight = 1.0 );
+  // ( a copy is a new constraint, with a serial number of its own)
+  Constraint( const Constraint & cn);
   virtual ~Constraint();
 
+  // Return the serial number of the constraint.  Like variables ( see
+  // AbstractVariable::Id()), constraints are numbered in the order they
+  // are made and ordered by number, but oldest first, so that they are
+  // listed in that order.
+  long Id() const { return _id; }
+
   // Return (copyof) my linear Expression.
   // For linear equations, this constraint represents Expression=0;
   // for linear inequalities it represents Expression>=0.
@@ -109,6 +117,15 @@ public:
   void * Pv() const { return _pv; }
 #endif
 
+  // A hash of what this constraint says -- its kind, strength, weight
+  // and expression -- rather than of which object it is.  Constraints
+  // for which FIsStructurallyEqual() holds hash alike.
+  size_t StructuralHash() const;
+
+  // Return true if cn says the same thing as this constraint, term for
+  // term and with the same strength and weight
+  bool FIsStructurallyEqual( const Constraint & cn) const;
+
   virtual bool FIsSatisfied() const { return false; }
   virtual bool FIsInSolver() const { return _times_added != 0; }
   virtual bool FIsOkayForSimplexSolver() const { return true; }
@@ -157,10 +174,10 @@ private:
   }
 
   void addedTo( const SimplexSolver & )
-    { ++_times_added; }
+    { ATOMIC_ADD( &_times_added, 1); }
 
   void removedFrom( const SimplexSolver & )
-    { --_times_added; }
+    { ATOMIC_ADD( &_times_added, -1); }
 
   void setStrength( const Strength & strength )
     { _strength = strength; }
@@ -178,6 +195,9 @@ private:
   void * _pv;
 
   int _times_added;
+
+  const long _id;
+  static long iConstraintNumber;
 };
 
 #include "Constraint_P.h"
@@ -5,6 +5,8 @@ class Constraint;                   //no need to be known
 #include "my/refcntp.h"
 REFCOUNT_DECL( Constraint)          //from refcntp.h
 typedef RefCountPtr< Constraint> P_Constraint;
+// Order constraints by Constraint::Id() rather than by address
+bool operator<( const P_Constraint & pcn1, const P_Constraint & pcn2);
 //static/stack vars
 typedef RefCountPtr_static_holder< Constraint> P_Constraint_holder;
 
@@ -38,3 +38,11 @@ void ExCLRequiredFailureWithExplanation::AddConstraint( P_Constraint cnExpl) {
     _explanation.insert( cnExpl); 
     _msg += _AddConstraint( cnExpl); 
 }
+
+void ExCLParseError::SetPosition( int line, int column) {
+    _line = line;
+    _column = column;
+    ostringstream ss;
+    ss << " ( line " << line << ", column " << column << ")";
+    _msg += ss.str();
+}
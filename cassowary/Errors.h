@@ -22,6 +22,18 @@
 #include "Typedefs.h"
 #include <stdexcept>
 
+// What the solver's Try...() functions return instead of throwing:
+// clsOk, or the kind of exception the throwing function would have
+// thrown
+enum ClStatus {
+  clsOk = 0,
+  clsRequiredFailure,    // ExCLRequiredFailure
+  clsTooDifficult,       // ExCLTooDifficult and its subclasses
+  clsEditMisuse,         // ExCLEditMisuse
+  clsConstraintNotFound, // ExCLConstraintNotFound
+  clsTransactionMisuse   // ExCLTransactionMisuse
+};
+
 class ExCLError : public exception
 #ifdef USE_GC
 , public gc
@@ -58,6 +70,13 @@ class ExCLEditMisuse : public ExCLError {
         , sz) {}
 };
 
+class ExCLTransactionMisuse : public ExCLError {
+ public:
+  ExCLTransactionMisuse( string sz) : ExCLError(
+        "ExCLTransactionMisuse: Transaction protocol usage violation"
+        , sz) {}
+};
+
 
 class ExCLTooDifficult : public ExCLError {
  protected:
@@ -129,11 +148,34 @@ class ExCLConstraintNotFound : public ExCLError {
     void AddConstraint( P_Constraint cnExpl);
 };
 
+class ExCLVariableInUse : public ExCLError {
+ public:
+    ExCLVariableInUse( string sz) : ExCLError(
+        "ExCLVariableInUse: Tried to remove a variable that a constraint still refers to"
+        , sz) {}
+};
+
+class ExCLSolverFileError : public ExCLError {
+ public:
+    ExCLSolverFileError( string sz) : ExCLError(
+        "ExCLSolverFileError: Could not save or load the solver"
+        , sz) {}
+};
+
 class ExCLParseError : public ExCLError {
  public:
     ExCLParseError() : ExCLError(
         "ExCLParseError"
-        ) {}
+        ), _line( 0), _column( 0) {}
+
+    // Where in the input the error was found ( 1-based; 0 if unknown)
+    int Line() const { return _line; }
+    int Column() const { return _column; }
+    void SetPosition( int line, int column);
+
+ protected:
+    int _line;
+    int _column;
 };
 
 class ExCLParseErrorMisc : public ExCLParseError {
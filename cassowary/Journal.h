@@ -0,0 +1,231 @@
+// $Id$
+//
+// Cassowary Incremental Constraint Solver
+// Original Smalltalk Implementation by Alan Borning
+// This C++ Implementation by Greg J. Badros, <gjb@cs.washington.edu>
+// http://www.cs.washington.edu/homes/gjb
+// ( C) 1998, 1999 Greg J. Badros and Alan Borning
+// See ../LICENSE for legal details regarding this software
+//
+// Journal.h
+// A log of changes to data structures, kept to undo them
+
+#ifndef Journal_H
+#define Journal_H
+
+#if defined( HAVE_CONFIG_H) && !defined( CONFIG_H_INCLUDED) && !defined( CONFIG_INLINE_H_INCLUDED)
+#include <cassowary/config-inline.h>
+#define CONFIG_INLINE_H_INCLUDED
+#endif
+
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Before each change it is told about, a journal records what it
+// takes to undo that change.  RollbackTo() then undoes the changes
+// recorded since some point, the latest first.  Whatever is recorded
+// has to outlive its entries.
+class Journal {
+ public:
+  // How to undo one change
+  class Entry {
+   public:
+    virtual ~Entry() { }
+    virtual void Undo() = 0;
+  };
+
+  Journal()
+    { }
+
+  ~Journal()
+    { ForgetFrom( 0); }
+
+  // map[key] is about to be changed, added or erased
+  template <class M>
+  void SaveEntry( M & map, const typename M::key_type & key)
+    {
+    typename M::iterator it = map.find( key);
+    if ( it == map.end())
+      Add( new NewMapEntry<M>( map, key));
+    else
+      Add( new MapEntry<M>( map, key, (*it).second));
+    }
+
+  // x is about to be inserted into set or erased from it
+  template <class S>
+  void SaveMember( S & set, const typename S::value_type & x)
+    { Add( new SetMember<S>( set, x, set.find( x) != set.end())); }
+
+  // x is about to be inserted into the set map[key] ( which is made if
+  // need be) or erased from it
+  template <class M>
+  void SaveMapMember( M & map, const typename M::key_type & key,
+                      const typename M::mapped_type::value_type & x)
+    {
+    typename M::iterator it = map.find( key);
+    if ( it == map.end())
+      Add( new MapMember<M>( map, key, x, false, false));
+    else
+      Add( new MapMember<M>( map, key, x, true, (*it).second.find( x) != (*it).second.end()));
+    }
+
+  // x is about to be changed
+  template <class T>
+  void SaveValue( T & x)
+    { Add( new Value<T>( x)); }
+
+  // v is about to be appended to ( and no more than that)
+  template <class V>
+  void SaveSize( V & v)
+    { Add( new Size<V>( v)); }
+
+  // Take ownership of pentry, to undo its change along with the others
+  void Add( Entry * pentry)
+    { _entries.push_back( pentry); }
+
+  // The number of changes recorded
+  size_t CEntries() const
+    { return _entries.size(); }
+
+  // Undo the changes recorded since there were cEntries of them, the
+  // latest first, and forget them
+  void RollbackTo( size_t cEntries)
+    {
+    while ( _entries.size() > cEntries)
+      {
+      Entry * pentry = _entries.back();
+      _entries.pop_back();
+      pentry->Undo();
+      delete pentry;
+      }
+    }
+
+  // Forget the changes recorded since there were cEntries of them,
+  // leaving them done
+  void ForgetFrom( size_t cEntries)
+    {
+    for ( size_t i = cEntries; i < _entries.size(); ++i)
+      delete _entries[i];
+    _entries.resize( cEntries);
+    }
+
+ private:
+  template <class M>
+  class MapEntry : public Entry {
+   public:
+    MapEntry( M & map, const typename M::key_type & key,
+              const typename M::mapped_type & value)
+        : _map( map), _key( key), _value( value)
+      { }
+    void Undo()
+      {
+      // insert rather than [], which would make a value just to
+      // assign over it
+      pair<typename M::iterator, bool> ins =
+        _map.insert( typename M::value_type( _key, _value));
+      if ( !ins.second)
+        (*ins.first).second = _value;
+      }
+   private:
+    M & _map;
+    typename M::key_type _key;
+    typename M::mapped_type _value;
+  };
+
+  template <class M>
+  class NewMapEntry : public Entry {
+   public:
+    NewMapEntry( M & map, const typename M::key_type & key)
+        : _map( map), _key( key)
+      { }
+    void Undo()
+      { _map.erase( _key); }
+   private:
+    M & _map;
+    typename M::key_type _key;
+  };
+
+  template <class S>
+  class SetMember : public Entry {
+   public:
+    SetMember( S & set, const typename S::value_type & x, bool fMember)
+        : _set( set), _x( x), _fMember( fMember)
+      { }
+    void Undo()
+      {
+      if ( _fMember)
+        _set.insert( _x);
+      else
+        _set.erase( _x);
+      }
+   private:
+    S & _set;
+    typename S::value_type _x;
+    bool _fMember;
+  };
+
+  template <class M>
+  class MapMember : public Entry {
+   public:
+    MapMember( M & map, const typename M::key_type & key,
+               const typename M::mapped_type::value_type & x,
+               bool fKey, bool fMember)
+        : _map( map), _key( key), _x( x), _fKey( fKey), _fMember( fMember)
+      { }
+    void Undo()
+      {
+      if ( _fMember)
+        {
+        _map[_key].insert( _x);
+        return;
+        }
+      typename M::iterator it = _map.find( _key);
+      if ( it == _map.end())
+        return;
+      (*it).second.erase( _x);
+      if ( !_fKey)
+        _map.erase( it);
+      }
+   private:
+    M & _map;
+    typename M::key_type _key;
+    typename M::mapped_type::value_type _x;
+    bool _fKey;
+    bool _fMember;
+  };
+
+  template <class T>
+  class Value : public Entry {
+   public:
+    Value( T & x)
+        : _x( x), _value( x)
+      { }
+    void Undo()
+      { _x = _value; }
+   private:
+    T & _x;
+    T _value;
+  };
+
+  template <class V>
+  class Size : public Entry {
+   public:
+    Size( V & v)
+        : _v( v), _size( v.size())
+      { }
+    void Undo()
+      { _v.erase( _v.begin() + _size, _v.end()); }
+   private:
+    V & _v;
+    typename V::size_type _size;
+  };
+
+  Journal( const Journal &);
+  Journal & operator=( const Journal &);
+
+  vector<Entry *> _entries;
+};
+
+#endif
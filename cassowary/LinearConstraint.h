@@ -40,6 +40,9 @@ class LinearConstraint : public Constraint {
   // represents Expression>=0.)
     LinearExpression Expression() const { return _expression; }
 
+  // Expression() without the copy
+    const LinearExpression & ConstExpression() const { return _expression; }
+
   // do not do this if * this is inside a solver
     void ChangeConstant( Number constant) { _expression.Set_constant( constant); }
 
@@ -0,0 +1,464 @@
+// $Id$
+//
+// Cassowary Incremental Constraint Solver
+// Original Smalltalk Implementation by Alan Borning
+// This C++ Implementation by Greg J. Badros, <gjb@cs.washington.edu>
+// http://www.cs.washington.edu/homes/gjb
+// ( C) 1998, 1999 Greg J. Badros and Alan Borning
+// See ../LICENSE for legal details regarding this software
+//
+// Reader.cc
+
+#include "Reader.h"
+#include "SimplexSolver.h"
+#include "LinearEquation.h"
+#include "LinearInequality.h"
+#include "StayConstraint.h"
+#include "Errors.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_CONFIG_H
+#include <cassowary/config.h>
+#define CONFIG_H_INCLUDED
+#endif
+
+static bool
+FIsIdentifierStart( char ch)
+{
+  return isalpha( (unsigned char) ch) || ch == '_';
+}
+
+static bool
+FIsIdentifierChar( char ch)
+{
+  return isalnum( (unsigned char) ch) || ch == '_' || ch == '.';
+}
+
+static bool
+FIsKeyword( const string & name)
+{
+  return name == "var" || name == "stay" || name == "edit";
+}
+
+ModelReader::ModelReader( SimplexSolver & solver, StringToVarMap & vars) :
+    _solver( solver),
+    _vars( vars),
+    _cBatch( 10000),
+    _cStatements( 0),
+    _iLine( 0),
+    _ich( 0),
+    _ichToken( 0)
+{ }
+
+ModelReader &
+ModelReader::Feed( const char * pb, size_t cb)
+{
+  const char * pbEnd = pb + cb;
+  for ( ; ; )
+    {
+    const char * pchNewline = static_cast<const char * >( memchr( pb, '\n', pbEnd - pb));
+    if ( !pchNewline)
+      break;
+    if ( _rest.empty())
+      _line.assign( pb, pchNewline);
+    else
+      {
+      _rest.append( pb, pchNewline);
+      _line.swap( _rest);
+      _rest.clear();
+      }
+    ParseLine();
+    pb = pchNewline + 1;
+    }
+  _rest.append( pb, pbEnd);
+  return *this;
+}
+
+ModelReader &
+ModelReader::Finish()
+{
+  if ( !_rest.empty())
+    {
+    _line.swap( _rest);
+    _rest.clear();
+    ParseLine();
+    }
+  Flush();
+  return *this;
+}
+
+#ifndef CL_NO_IO
+ModelReader &
+ModelReader::Read( istream & xi)
+{
+  char rgch[65536];
+  while ( xi)
+    {
+    xi.read( rgch, sizeof( rgch));
+    Feed( rgch, xi.gcount());
+    }
+  return Finish();
+}
+#endif
+
+ModelReader &
+ModelReader::ReadFile( const char * path)
+{
+  FILE * pf = fopen( path, "rb");
+  if ( !pf)
+    throw ExCLParseErrorMisc( string( "Cannot open ") + path);
+  char rgch[65536];
+  size_t cch;
+  try
+    {
+    while ( ( cch = fread( rgch, 1, sizeof( rgch), pf)) > 0)
+      Feed( rgch, cch);
+    }
+  catch ( ... )
+    {
+    fclose( pf);
+    throw;
+    }
+  bool fOk = !ferror( pf);
+  fclose( pf);
+  if ( !fOk)
+    throw ExCLParseErrorMisc( string( "Cannot read ") + path);
+  return Finish();
+}
+
+void
+ModelReader::ParseLine()
+{
+  ++_iLine;
+  _ich = 0;
+  if ( !_line.empty() && _line[_line.size() - 1] == '\r')
+    _line.resize( _line.size() - 1);
+  for ( ; ; )
+    {
+    if ( Peek())
+      {
+      ParseStatement();
+      if ( Peek())
+        Error( "Expected the end of the statement");
+      }
+    if ( _ich < _line.size() && _line[_ich] == ';')
+      ++_ich;
+    else
+      break;
+    }
+}
+
+void
+ModelReader::ParseStatement()
+{
+  size_t ich = _ich;
+  while ( ich < _line.size() && FIsIdentifierChar( _line[ich]))
+    ++ich;
+  string word = _line.substr( _ich, ich - _ich);
+  if ( word == "var")
+    {
+    _ich = ich;
+    ParseDeclarations();
+    }
+  else if ( word == "stay" || word == "edit")
+    {
+    _ich = ich;
+    ParseEditsOrStays( word == "edit");
+    }
+  else
+    {
+    ParseConstraint();
+    }
+}
+
+void
+ModelReader::ParseDeclarations()
+{
+  do
+    {
+    string name = ParseIdentifier( "a variable name");
+    if ( FIsKeyword( name))
+      Error( "'" + name + "' cannot name a variable");
+    bool fValue = FAccept( '=');
+    double value = fValue? ParseNumber() : 0.0;
+    StringToVarMap::iterator it = _vars.find( name);
+    if ( it != _vars.end())
+      {
+      if ( fValue)
+        (*it).second.SetValue( value);
+      }
+    else
+      {
+      _vars.insert( StringToVarMap::value_type( name, Variable( name, value)));
+      }
+    }
+  while ( FAccept( ','));
+}
+
+void
+ModelReader::ParseEditsOrStays( bool fEdit)
+{
+  VarVector vars;
+  do
+    {
+    vars.push_back( LookUp( ParseIdentifier( "a variable")));
+    }
+  while ( FAccept( ','));
+  Strength strength = fEdit? sStrong() : sWeak();
+  double weight = 1.0;
+  ParseModifiers( strength, weight);
+  ++_cStatements;
+
+  if ( fEdit)
+    {
+    // edits cannot go through AddConstraints, and take the constraints
+    // before them into account
+    Flush();
+    for ( size_t i = 0; i < vars.size(); ++i)
+      _solver.AddEditVar( vars[i], strength, weight);
+    }
+  else
+    {
+    for ( size_t i = 0; i < vars.size(); ++i)
+      _pending.push_back( new StayConstraint( vars[i], strength, weight));
+    if ( _cBatch > 0 && _pending.size() >= _cBatch)
+      Flush();
+    }
+}
+
+void
+ModelReader::ParseConstraint()
+{
+  LinearExpression lhs;
+  ParseExpression( lhs);
+
+  char ch = Peek();
+  CnRelation op = cnEQ;
+  if ( ch == '=')
+    {
+    // = or ==, but not = =
+    ++_ich;
+    if ( _ich < _line.size() && _line[_ich] == '=')
+      ++_ich;
+    op = cnEQ;
+    }
+  else if ( ch == '<' || ch == '>')
+    {
+    ++_ich;
+    if ( _ich >= _line.size() || _line[_ich] != '=')
+      Error( "Strict inequalities are not supported");
+    ++_ich;
+    op = ( ch == '<')? cnLEQ : cnGEQ;
+    }
+  else
+    {
+    Error( "Expected ==, <= or >=");
+    }
+
+  LinearExpression rhs;
+  ParseExpression( rhs);
+  Strength strength = sRequired();
+  double weight = 1.0;
+  ParseModifiers( strength, weight);
+  ++_cStatements;
+
+  if ( op == cnEQ)
+    _pending.push_back( new LinearEquation( lhs, rhs, strength, weight));
+  else
+    _pending.push_back( new LinearInequality( lhs, op, rhs, strength, weight));
+  if ( _cBatch > 0 && _pending.size() >= _cBatch)
+    Flush();
+}
+
+void
+ModelReader::ParseModifiers( Strength & strength, double & weight)
+{
+  while ( FAccept( '|'))
+    {
+    char ch = Peek();
+    if ( isdigit( (unsigned char) ch) || ch == '.' || ch == '+' || ch == '-')
+      {
+      weight = ParseNumber();
+      if (!( weight > 0.0))
+        Error( "The weight must be positive");
+      continue;
+      }
+    string name = ParseIdentifier( "a strength or a weight");
+    if ( name == "required")
+      strength = sRequired();
+    else if ( name == "strong")
+      strength = sStrong();
+    else if ( name == "medium")
+      strength = sMedium();
+    else if ( name == "weak")
+      strength = sWeak();
+    else
+      {
+      ExCLParseErrorBadIdentifier e( name);
+      e.SetPosition( _iLine, _ichToken + 1);
+      throw e;
+      }
+    }
+}
+
+void
+ModelReader::ParseExpression( LinearExpression & expr)
+{
+  ParseTerm( expr);
+  for ( ; ; )
+    {
+    char ch = Peek();
+    if ( ch != '+' && ch != '-')
+      break;
+    ++_ich;
+    LinearExpression term;
+    ParseTerm( term);
+    expr.AddExpression( term, ( ch == '+')? 1.0 : -1.0);
+    }
+}
+
+void
+ModelReader::ParseTerm( LinearExpression & expr)
+{
+  ParseFactor( expr);
+  for ( ; ; )
+    {
+    char ch = Peek();
+    if ( ch != '*' && ch != '/')
+      break;
+    ++_ich;
+    LinearExpression factor;
+    ParseFactor( factor);
+    if ( ch == '*')
+      {
+      if ( !expr.IsConstant() && !factor.IsConstant())
+        Error( "The expression is not linear");
+      expr = expr.Times( factor);
+      }
+    else
+      {
+      if ( !factor.IsConstant())
+        Error( "The expression is not linear");
+      if ( factor.Constant() == 0.0)
+        Error( "Division by zero");
+      expr = expr.Divide( factor.Constant());
+      }
+    }
+}
+
+void
+ModelReader::ParseFactor( LinearExpression & expr)
+{
+  char ch = Peek();
+  if ( ch == '+' || ch == '-')
+    {
+    ++_ich;
+    ParseFactor( expr);
+    if ( ch == '-')
+      expr = expr.Times( -1.0);
+    }
+  else if ( ch == '(')
+    {
+    ++_ich;
+    ParseExpression( expr);
+    Expect( ')', "')'");
+    }
+  else if ( isdigit( (unsigned char) ch) || ch == '.')
+    {
+    expr = LinearExpression( ParseNumber());
+    }
+  else if ( FIsIdentifierStart( ch))
+    {
+    expr = LinearExpression( LookUp( ParseIdentifier( "a variable")));
+    }
+  else
+    {
+    Error( "Expected a number, a variable or '('");
+    }
+}
+
+char
+ModelReader::Peek()
+{
+  while ( _ich < _line.size() &&
+          ( _line[_ich] == ' ' || _line[_ich] == '\t' || _line[_ich] == '\r'))
+    ++_ich;
+  _ichToken = _ich;
+  if ( _ich >= _line.size() || _line[_ich] == '#' || _line[_ich] == ';')
+    return 0;
+  return _line[_ich];
+}
+
+bool
+ModelReader::FAccept( char ch)
+{
+  if ( Peek() != ch)
+    return false;
+  ++_ich;
+  return true;
+}
+
+void
+ModelReader::Expect( char ch, const char * szWhat)
+{
+  if ( !FAccept( ch))
+    Error( string( "Expected ") + szWhat);
+}
+
+string
+ModelReader::ParseIdentifier( const char * szWhat)
+{
+  if ( !FIsIdentifierStart( Peek()))
+    Error( string( "Expected ") + szWhat);
+  size_t ichStart = _ich;
+  while ( _ich < _line.size() && FIsIdentifierChar( _line[_ich]))
+    ++_ich;
+  return _line.substr( ichStart, _ich - ichStart);
+}
+
+double
+ModelReader::ParseNumber()
+{
+  Peek();
+  const char * pchStart = _line.c_str() + _ich;
+  char * pchEnd;
+  double x = strtod( pchStart, &pchEnd);
+  if ( pchEnd == pchStart)
+    Error( "Expected a number");
+  _ich += pchEnd - pchStart;
+  return x;
+}
+
+Variable
+ModelReader::LookUp( const string & name)
+{
+  StringToVarMap::iterator it = _vars.find( name);
+  if ( it == _vars.end())
+    {
+    ExCLParseErrorBadIdentifier e( name);
+    e.SetPosition( _iLine, _ichToken + 1);
+    throw e;
+    }
+  return (*it).second;
+}
+
+void
+ModelReader::Error( const string & what)
+{
+  ExCLParseErrorMisc e( what);
+  e.SetPosition( _iLine, _ichToken + 1);
+  throw e;
+}
+
+void
+ModelReader::Flush()
+{
+  if ( _pending.empty())
+    return;
+  vector<P_Constraint> pending;
+  pending.swap( _pending);
+  _solver.AddConstraints( pending, &_failed);
+}
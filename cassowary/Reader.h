@@ -0,0 +1,139 @@
+// $Id$
+//
+// Cassowary Incremental Constraint Solver
+// Original Smalltalk Implementation by Alan Borning
+// This C++ Implementation by Greg J. Badros, <gjb@cs.washington.edu>
+// http://www.cs.washington.edu/homes/gjb
+// ( C) 1998, 1999 Greg J. Badros and Alan Borning
+// See ../LICENSE for legal details regarding this software
+//
+// Reader.h
+// Reads constraint models written as text into a solver
+
+#ifndef Reader_H
+#define Reader_H
+
+#if defined( HAVE_CONFIG_H) && !defined( CONFIG_H_INCLUDED) && !defined( CONFIG_INLINE_H_INCLUDED)
+#include <cassowary/config-inline.h>
+#define CONFIG_INLINE_H_INCLUDED
+#endif
+
+#include "Cassowary.h"
+#include "Variable.h"
+#include "Strength.h"
+#include "LinearExpression.h"
+#include "Typedefs.h"
+#include <string>
+#include <vector>
+
+#ifndef CL_NO_IO
+#include <iostream>
+#endif
+
+class SimplexSolver;
+
+// A model is a sequence of statements, each ending at the end of its
+// line or at a ';':
+//
+//   # a comment, up to the end of the line
+//   var x = 10, y, w = 100        declare variables ( with values)
+//   x + 2*y <= w - 5 | strong | 2  a constraint, with its strength
+//                                  and positive weight ( by default
+//                                  required, 1)
+//   stay x, y | weak               stays ( weak by default)
+//   edit w | strong                edit variables ( strong by default)
+//
+// The relations are ==, =, <= and >=.  Expressions have to be linear,
+// and are made of numbers and variables with +, -, *, / and
+// parentheses.  A variable has to be declared before it is used,
+// unless it is already in the map given to the reader.  The strengths
+// are required, strong, medium and weak.
+//
+// The reader parses the model as it is fed, a line at a time, and
+// adds the constraints to the solver in batches with AddConstraints().
+// Errors in the text throw an ExCLParseError that gives where they are.
+class ModelReader {
+ public:
+  // Read into solver, looking up and declaring the variables in vars
+  ModelReader( SimplexSolver & solver, StringToVarMap & vars);
+
+  // Read the next cb bytes of the model.  The lines that are complete
+  // are parsed right away; the rest waits for more.
+  ModelReader & Feed( const char * pb, size_t cb);
+
+  ModelReader & Feed( const string & s)
+    { return Feed( s.data(), s.size()); }
+
+  // Parse what is left of the model and add the constraints still
+  // waiting to be added
+  ModelReader & Finish();
+
+#ifndef CL_NO_IO
+  // Feed all of xi, a chunk at a time, then Finish()
+  ModelReader & Read( istream & xi);
+#endif
+
+  // Feed the file at path, a chunk at a time, then Finish()
+  ModelReader & ReadFile( const char * path);
+
+  // Add the constraints read to the solver once this many are waiting
+  // ( and before each edit and at the end).  0 waits until the end.
+  ModelReader & SetBatchSize( size_t n)
+    { _cBatch = n; return *this; }
+
+  // The required constraints the solver could not satisfy along with
+  // the others, which were left out
+  const vector<P_Constraint> & FailedConstraints() const
+    { return _failed; }
+
+  // The number of constraints, stays and edits read so far
+  long CStatements() const
+    { return _cStatements; }
+
+ protected:
+  // Parse the statements of the whole line in _line
+  void ParseLine();
+  void ParseStatement();
+  void ParseDeclarations();
+  void ParseEditsOrStays( bool fEdit);
+  void ParseConstraint();
+
+  // [ '|' strength ] [ '|' weight ], in either order
+  void ParseModifiers( Strength & strength, double & weight);
+
+  void ParseExpression( LinearExpression & expr);
+  void ParseTerm( LinearExpression & expr);
+  void ParseFactor( LinearExpression & expr);
+
+  // Skip blanks; return the next character, or 0 at the end of the
+  // statement ( a ';', a comment or the end of the line)
+  char Peek();
+  bool FAccept( char ch);
+  void Expect( char ch, const char * szWhat);
+  string ParseIdentifier( const char * szWhat);
+  double ParseNumber();
+  Variable LookUp( const string & name);
+
+  // Throw an ExCLParseErrorMisc saying what went wrong where
+  void Error( const string & what);
+
+  // Add the constraints waiting to be added
+  void Flush();
+
+  SimplexSolver & _solver;
+  StringToVarMap & _vars;
+  size_t _cBatch;
+  vector<P_Constraint> _pending;
+  vector<P_Constraint> _failed;
+  long _cStatements;
+
+  // what is left of the input after the last complete line
+  string _rest;
+  // the line being parsed, its number and where in it the parser is
+  string _line;
+  int _iLine;
+  size_t _ich;
+  size_t _ichToken;
+};
+
+#endif
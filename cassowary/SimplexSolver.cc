@@ -10,6 +10,7 @@
 // SimplexSolver.cc
 
 #include "SimplexSolver.h"
+#include "LinearEquation.h"
 #include "LinearInequality.h"
 #include "StayConstraint.h"
 #include "EditConstraint.h"
@@ -20,11 +21,40 @@
 #include "ObjectiveVariable.h"
 #include "DummyVariable.h"
 #include <algorithm>
+#include <ctype.h>
 #include <float.h>
+#include <math.h>
 #include <sstream>
 #include <queue>
+#include <map>
+#include <set>
+#include <limits>
+#include <stdio.h>
+#include <string.h>
 #include "debug.h"
 
+// SolveScenarios() uses POSIX threads unless told not to ( or there are
+// none), in which case it solves the scenarios one after the other
+#if defined( _MSC_VER) && !defined( CL_NO_THREADS)
+#define CL_NO_THREADS
+#endif
+#ifndef CL_NO_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+// LoadFile() maps the file into memory unless told not to ( or it
+// cannot), in which case it reads it in
+#if defined( _MSC_VER) && !defined( CL_NO_MMAP)
+#define CL_NO_MMAP
+#endif
+#ifndef CL_NO_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #ifdef HAVE_CONFIG_H
 #include <cassowary/config.h>
 #define CONFIG_H_INCLUDED
@@ -55,7 +85,10 @@ class SimplexSolver::EditInfo {
         :_clv( clv),
          _pconstraint( pconstraint),
          _clvEditPlus( eplus), _clvEditMinus( eminus),
-         _prevEditConstant( prevEditConstant)
+         _prevEditConstant( prevEditConstant),
+         _errorWeight( pconstraint? 
+                       pconstraint->weight() * pconstraint->strength().symbolicWeight().AsDouble() : 0.0),
+         _fInUse( false)
       { }
     
     ~EditInfo() { REFCOUNT_DIE( EditInfo) }
@@ -76,6 +109,14 @@ class SimplexSolver::EditInfo {
     Variable _clvEditPlus;
     Variable _clvEditMinus;
     Number _prevEditConstant;
+    // the weight of the error variables in the objective.  Edit slots
+    // change it ( to 0 while parked) without touching the constraint,
+    // which other solvers may share.
+    Number _errorWeight;
+    // where this is in _editInfoList, when it is there
+    EditInfoList::iterator _itList;
+    // whether this is the entry for its variable in _editInfoMap
+    bool _fInUse;
 };
 
 #include "my/refcntp.h"
@@ -89,35 +130,125 @@ ostream & operator<<( ostream & xo, const SimplexSolver::EditInfoList & listPEdi
 
 
 SimplexSolver::P_EditInfo SimplexSolver::PEditInfoFromv( const Variable & clv) {
-    EditInfoList::iterator it = _editInfoList.begin();
-    for (; it != _editInfoList.end(); ++it) {
-      P_EditInfo pei = (*it);
-      if ( pei->_clv == clv)
-        return pei;
+    VarToEditInfoMap::iterator it = _editInfoMap.find( clv);
+    if ( it == _editInfoMap.end())
+      return NULL;
+    return (*it).second;
+}
+
+// The weight of pcn's error variables in the objective, as this
+// solver has it: kept in _errorWeights, or in the EditInfo of an edit
+// constraint.  For a constraint not in the solver, its strength times
+// its weight.
+Number SimplexSolver::ErrorWeight( P_Constraint pcn) const {
+    if ( pcn->IsEditConstraint()) {
+      const Variable & v = dynamic_cast<EditConstraint * >( pcn.ptr())->variable();
+      VarToEditInfoMap::const_iterator it = _editInfoMap.find( v);
+      if ( it != _editInfoMap.end() && (*it).second->_pconstraint == pcn)
+        return (*it).second->_errorWeight;
+      it = _editSlots.find( v);
+      if ( it != _editSlots.end() && (*it).second->_pconstraint == pcn)
+        return (*it).second->_errorWeight;
     }
-    return NULL;
+    else {
+      ConstraintToNumberMap::const_iterator it = _errorWeights.find( pcn);
+      if ( it != _errorWeights.end())
+        return (*it).second;
+    }
+    return pcn->weight() * pcn->strength().symbolicWeight().AsDouble();
+}
+
+// Append the full entry pcei to _editInfoList and index it
+void SimplexSolver::NoteEditInUse( P_EditInfo pcei) {
+    pcei->_itList = _editInfoList.insert( _editInfoList.end(), pcei);
+    _editInfoMap[pcei->_clv] = pcei;
+    pcei->_fInUse = true;
+    ClearRegionCache();
+}
+
+void SimplexSolver::NoteEditDone( P_EditInfo pcei) {
+    _editInfoList.erase( pcei->_itList);
+    _editInfoMap.erase( pcei->_clv);
+    pcei->_fInUse = false;
+    ClearRegionCache();
+}
+
+// What a constraint with marker variable marker, whose error variables
+// have weight coeff in the objective, adds to the fingerprint of the
+// active constraints: a hash of the two
+static size_t
+FingerprintTerm( const Variable & marker, double coeff)
+{
+  long id = marker.Id();
+  size_t h = 2166136261u;
+  const unsigned char * pb = reinterpret_cast<const unsigned char * >(&id);
+  size_t i;
+  for ( i = 0; i < sizeof( id); ++i)
+    h = ( h ^ pb[i]) * 16777619;
+  pb = reinterpret_cast<const unsigned char * >(&coeff);
+  for ( i = 0; i < sizeof( coeff); ++i)
+    h = ( h ^ pb[i]) * 16777619;
+  return h;
 }
 
 SimplexSolver & SimplexSolver::RemoveEditVar( const Variable & v) {
+      CheckNoTransaction("RemoveEditVar");
       P_EditInfo pcei = PEditInfoFromv( v);
       if (!pcei) {
         throw ExCLEditMisuse("Removing edit variable that was not found");
       }
+      if ( FHasEditSlot( v)) {
+        ParkEditSlot( pcei);
+        return *this;
+      }
       P_Constraint pcnEdit = pcei->_pconstraint;
       RemoveConstraint( pcnEdit);
       return *this;
 }
+
+SimplexSolver & SimplexSolver::AddEditSlot( const Variable & v) {
+      CheckNoTransaction("AddEditSlot");
+      if ( FHasEditSlot( v))
+        return *this;
+      if ( PEditInfoFromv( v))
+        throw ExCLEditMisuse("AddEditSlot called on a variable being edited");
+      // ( an objective coefficient cannot start out at 0, so add it
+      // in use and then park it)
+      AddConstraint( new EditConstraint( v, sStrong()));
+      P_EditInfo pcei = PEditInfoFromv( v);
+      ParkEditSlot( pcei);
+      _editSlots[v] = pcei;
+      return *this;
+}
+
+SimplexSolver & SimplexSolver::RemoveEditSlot( const Variable & v) {
+      CheckNoTransaction("RemoveEditSlot");
+      VarToEditInfoMap::iterator it_slot = _editSlots.find( v);
+      if ( it_slot == _editSlots.end())
+        throw ExCLEditMisuse("Removing edit slot that was not found");
+      P_EditInfo pcei = (*it_slot).second;
+      _editSlots.erase( it_slot);
+      if (!PEditInfoFromv( v)) {
+        // let RemoveConstraint find it as an edit in use
+        NoteEditInUse( pcei);
+      }
+      RemoveConstraint( pcei->_pconstraint);
+      return *this;
+}
 SimplexSolver & SimplexSolver::BeginEdit() {
+      CheckNoTransaction("BeginEdit");
       if ( _editInfoList.size() == 0) {
         throw ExCLEditMisuse("BeginEdit called, but no edit variable");
       }
       // may later want to do more in here
+      CatchUpTableau();
       _infeasibleRows.clear();
       ResetStayConstants();
       _stkCedcns.push( _editInfoList.size());
       return *this;
 }
 SimplexSolver & SimplexSolver::EndEdit() {
+      CheckNoTransaction("EndEdit");
       if ( _editInfoList.size() == 0)
         throw ExCLEditMisuse("EndEdit called but no edit variables");
       Resolve();
@@ -134,6 +265,14 @@ SimplexSolver & SimplexSolver::AddUpperBound( Variable v, Number upper) {
     return AddConstraint( new LinearInequality( LinearExpression( upper - v)));
 }
 SimplexSolver & SimplexSolver::AddEditVar( const Variable & v, const Strength & strength, double weight ) { 
+    CheckNoTransaction("AddEditVar");
+    if (!strength.IsRequired() && !PEditInfoFromv( v)) {
+      VarToEditInfoMap::iterator it_slot = _editSlots.find( v);
+      if ( it_slot != _editSlots.end()) {
+        ActivateEditSlot((*it_slot).second, strength, weight);
+        return *this;
+      }
+    }
     return AddConstraint( new EditConstraint( v, strength, weight));
 }
 SimplexSolver & SimplexSolver::AddStay( const Variable & v, const Strength & strength, double weight ) {
@@ -142,6 +281,7 @@ SimplexSolver & SimplexSolver::AddStay( const Variable & v, const Strength & str
 
 SimplexSolver::SimplexSolver() :
     Solver(),
+    _psweptStayErrorVars( NULL),
     _objective( new ObjectiveVariable("Z")),
     _slackCounter( 0),
     _artificialCounter( 0),
@@ -151,10 +291,27 @@ SimplexSolver::SimplexSolver() :
     _dummyCounter( 0),
     _epsilon( 1e-8),
     _fResetStayConstantsAutomatically( true),
+    _fRemoveUnusedVariablesAutomatically( false),
     _fNeedsSolving( false),
+    _fExternalValuesInSync( false),
     _fExplainFailure( false),
+    _fMinimalExplanations( false),
+    _fWritesVariables( true),
+    _cSolutions( 0),
+    _cRegionCacheLimit( 0),
+    _fRegionRecorded( false),
+    _fTableauBehind( false),
+    _cRegionCacheHits( 0),
+    _cRegionCacheMisses( 0),
+    _activeFingerprint( 0),
+    _cBasisCacheLimit( 0),
+    _cBasisCacheHits( 0),
+    _cBasisCacheMisses( 0),
     _pfnResolveCallback( NULL),
-    _pfnCnSatCallback( NULL)
+    _pfnCnSatCallback( NULL),
+    _pfnChangesCallback( NULL),
+    _fTracksSatisfaction( false),
+    _changeTolerance( 0.0)
     { 
     _rows[_objective] = new LinearExpression(); 
     // start out with no edit variables
@@ -165,263 +322,1992 @@ SimplexSolver::SimplexSolver() :
 }
 
 
-SimplexSolver::~SimplexSolver()
-{
-#ifdef CL_SOLVER_STATS
-  cout << "_slackCounter == " << _slackCounter
-       << "\n_artificialCounter == " << _artificialCounter
-       << "\n_dummyCounter == " << _dummyCounter << endl;
-  cout << "stayMinusErrorVars " << _stayMinusErrorVars.size() << ", "
-       << "stayPlusErrorVars " << _stayPlusErrorVars.size() << ", "
-       << "errorVars " << _errorVars.size() << ", "
-       << "markerVars " << _markerVars.size() << endl;
+SimplexSolver::SimplexSolver( const SimplexSolver & solver) :
+    Solver( solver),
+    Tableau(),
+    _psweptStayErrorVars( NULL),
+    _epsilon( solver._epsilon),
+    _pfnResolveCallback( solver._pfnResolveCallback),
+    _pfnCnSatCallback( solver._pfnCnSatCallback),
+    _pfnChangesCallback( solver._pfnChangesCallback)
+    {
+#ifdef CL_PV
+    _pv = solver._pv;
 #endif
-  // Cannot print *this here, since local Variable-s may have been
-  // destructed already
-#ifdef CL_FIND_LEAK
-  cout << "die SimplexSolver== " << this << endl;
-#endif  
+    CopyStateFrom( solver);
+    // the variables are solver's, so leave them to it
+    _fWritesVariables = false;
 }
 
-// Add the constraint cn to the tableau
-SimplexSolver & 
-SimplexSolver::AddConstraint( P_Constraint pcn)
+// Copy the members one by one rather than assigning the whole solver,
+// since the edit entries cannot be shared and the constraints have to
+// be told they are in one more solver
+void
+SimplexSolver::CopyStateFrom( const SimplexSolver & solver)
 {
-#ifdef CL_TRACE
-  Tracer TRACER( __FUNCTION__);
-  cout << "(" << * pcn << ")" << endl;
+  // rolling a transaction back undoes into the rows in place, which
+  // would change the copy's shared rows too
+  solver.CheckNoTransaction("Copying a solver");
+  solver.ShareRows();
+  Tableau::operator=( solver);
+  SetJournal( NULL);
+
+  _stayMinusErrorVars = solver._stayMinusErrorVars;
+  _stayPlusErrorVars = solver._stayPlusErrorVars;
+  _errorVars = solver._errorVars;
+  _errorWeights = solver._errorWeights;
+  _markerVars = solver._markerVars;
+  _constraintsMarked = solver._constraintsMarked;
+  _objective = solver._objective;
+  _stayConstraints = solver._stayConstraints;
+  _varUseCounts = solver._varUseCounts;
+  _unusedVarCandidates = solver._unusedVarCandidates;
+  _groups = solver._groups;
+  _preparedConstraints = solver._preparedConstraints;
+  _slackCounter = solver._slackCounter;
+  _artificialCounter = solver._artificialCounter;
+#ifdef CL_FIND_LEAK
+  _cArtificialVarsDeleted = solver._cArtificialVarsDeleted;
 #endif
-  
-  if (!pcn->FIsOkayForSimplexSolver()) {
-    throw ExCLTooDifficultSpecial("SimplexSolver cannot handle this constraint object");
-  }
-
-  if ( pcn->IsStrictInequality()) {
-    // cannot handle strict inequalities
-    throw ExCLStrictInequalityNotAllowed();
-  }
-
-  if ( pcn->ReadOnlyVars().size() > 0) {
-    // cannot handle read-only vars
-    throw ExCLReadOnlyNotAllowed();
-  }
-
-  if ( pcn->IsEditConstraint())
+  _dummyCounter = solver._dummyCounter;
+  _fResetStayConstantsAutomatically = solver._fResetStayConstantsAutomatically;
+  _fRemoveUnusedVariablesAutomatically = solver._fRemoveUnusedVariablesAutomatically;
+  _fNeedsSolving = solver._fNeedsSolving;
+  _fExternalValuesInSync = solver._fExternalValuesInSync;
+  _editedExternalRows = solver._editedExternalRows;
+  _fExplainFailure = solver._fExplainFailure;
+  _fMinimalExplanations = solver._fMinimalExplanations;
+  _fWritesVariables = solver._fWritesVariables;
+  _cSolutions = solver._cSolutions;
+  _changeTolerance = solver._changeTolerance;
+  _reportedValues = solver._reportedValues;
+  _snappedValues = solver._snappedValues;
+  _fTracksSatisfaction = solver._fTracksSatisfaction;
+  _errorVarOwners = solver._errorVarOwners;
+  _unsatisfiedCns = solver._unsatisfiedCns;
+  _ptouchedRows = _fTracksSatisfaction? &_touchedRows : NULL;
+  _regions = solver._regions;
+  _cRegionCacheLimit = solver._cRegionCacheLimit;
+  _fRegionRecorded = solver._fRegionRecorded;
+  _fTableauBehind = solver._fTableauBehind;
+  _cRegionCacheHits = solver._cRegionCacheHits;
+  _cRegionCacheMisses = solver._cRegionCacheMisses;
+  _activeFingerprint = solver._activeFingerprint;
+  _bases = solver._bases;
+  _cBasisCacheLimit = solver._cBasisCacheLimit;
+  _cBasisCacheHits = solver._cBasisCacheHits;
+  _cBasisCacheMisses = solver._cBasisCacheMisses;
+  _stkCedcns = solver._stkCedcns;
+
+  // the edit entries are changed in place, so copy each one once,
+  // wherever it is referred to from
+  typedef Map<P_EditInfo, P_EditInfo> EditInfoCopyMap;
+  EditInfoCopyMap copies;
+  _editInfoList.clear();
+  EditInfoList::const_iterator it_edit = solver._editInfoList.begin();
+  for ( ; it_edit != solver._editInfoList.end(); ++it_edit)
     {
-    EditConstraint * pcnEdit = dynamic_cast<EditConstraint * >( pcn.ptr());
-    const Variable & v = pcnEdit->variable();
-    if (!v.IsExternal() ||
-        (!FIsBasicVar( v) && !ColumnsHasKey( v)))
-      {
-      // we could try to make this case work,
-      // but it'd be unnecessarily inefficient --
-      // and probably easier for the client application
-      // to deal with
-      throw ExCLEditMisuse("( ExCLEditMisuse) Edit constraint on variable not in tableau.");
-      }
-    P_EditInfo pcei = PEditInfoFromv( v);
-    if ( pcei)
-      {
-      // we need to only add a partial _editInfoList entry for this
-      // edit constraint since the variable is already being edited.
-      // otherwise a more complete entry is added later in this function
-      _editInfoList.push_back( new EditInfo( v, NULL, clvNil, clvNil, 0));
-      return *this;
-      }
+    P_EditInfo pcei = new EditInfo(**it_edit);
+    pcei->_itList = _editInfoList.insert( _editInfoList.end(), pcei);
+    copies[*it_edit] = pcei;
     }
-
-  Variable clvEplus, clvEminus;
-  Number prevEConstant;
-  P_LinearExpression expr = NewExpression( pcn, /* output to: */
-                                            clvEplus,clvEminus,
-                                            prevEConstant);
-  bool fAddedOkDirectly = false;
-
-  try 
+  _editInfoMap.clear();
+  VarToEditInfoMap::const_iterator it_map = solver._editInfoMap.begin();
+  for ( ; it_map != solver._editInfoMap.end(); ++it_map)
     {
-    // If possible Add expr directly to the appropriate tableau by
-    // choosing a subject for expr ( a variable to become basic) from
-    // among the current variables in expr.  If this doesn't work use an
-    // artificial variable.  After adding expr re-Optimize.
-    fAddedOkDirectly = TryAddingDirectly( expr);
+    _editInfoMap[(*it_map).first] = copies[(*it_map).second];
     }
-  catch ( ExCLRequiredFailure & error)
+  _editSlots.clear();
+  for ( it_map = solver._editSlots.begin(); it_map != solver._editSlots.end(); ++it_map)
     {
-#ifdef CL_TRACE
-    cout << "could not Add directly -- caught ExCLRequiredFailure error" << endl;
-#endif
-    RemoveConstraintInternal( pcn);
-    throw;
-    }
-
-  if (!fAddedOkDirectly)
-    { // could not Add directly
-    ExCLRequiredFailureWithExplanation e;
-    if (!AddWithArtificialVariable( expr, e))
-      {
-#ifdef CL_DEBUG_FAILURES
-      cout << "Failed solve! Could not Add constraint.\n"
-           << *this << endl;
-#endif
-      RemoveConstraintInternal( pcn);
-      if ( FIsExplaining())
-        throw e;
-      else
-        throw ExCLRequiredFailure();
-      }
+    // a parked slot is in neither of the above
+    P_EditInfo & pcei = copies[(*it_map).second];
+    if ( !pcei)
+      pcei = new EditInfo(*(*it_map).second);
+    _editSlots[(*it_map).first] = pcei;
     }
 
-  _fNeedsSolving = true;
-
-  if ( pcn->IsEditConstraint())
+  ConstraintToVarMap::const_iterator it_cn = _markerVars.begin();
+  for ( ; it_cn != _markerVars.end(); ++it_cn)
     {
-    EditConstraint * pcnEdit = dynamic_cast<EditConstraint * >( pcn.ptr());
-    const Variable & clv = pcnEdit->variable();
-    _editInfoList.push_back( new EditInfo( clv, pcnEdit, clvEplus, clvEminus,
-                                       prevEConstant));
+    (*it_cn).first->addedTo(*this);
     }
+}
 
-  if ( _fAutosolve)
+SimplexSolver &
+SimplexSolver::Restore( const SimplexSolver & snapshot)
+{
+  if ( &snapshot == this)
+    return *this;
+  CheckNoTransaction("Restore");
+  snapshot.CheckNoTransaction("Restoring from a solver");
+  ConstraintToVarMap::const_iterator it_cn = _markerVars.begin();
+  for ( ; it_cn != _markerVars.end(); ++it_cn)
     {
-    Optimize( _objective);
-    SetExternalVariables();
+    (*it_cn).first->removedFrom(*this);
     }
-
-  pcn->addedTo(*this);
+  bool fWritesVariables = _fWritesVariables;
+  CopyStateFrom( snapshot);
+  _fWritesVariables = fWritesVariables;
+  UpdateExternalVariables();
   return *this;
 }
 
-// Add weak stays to the x and y parts of each point. These have
-// increasing weights so that the solver will try to satisfy the x
-// and y stays on the same point, rather than the x stay on one and
-// the y stay on another.
-SimplexSolver & 
-SimplexSolver::AddPointStays( const vector<const Point * > & listOfPoints,
-                               const Strength & strength)
+// One of SolveScenarios()'s threads: the copy it solves on, and where
+// it puts the results
+struct ScenarioJob {
+  SimplexSolver * _psolver;
+  const SimplexSolver * _psnapshot;
+  const vector<SimplexSolver::Scenario> * _pscenarios;
+  const vector<Variable> * _pvars;
+  Number * _values;
+  long * _pnext;
+  size_t _cSolved;
+};
+
+void *
+SimplexSolver::RunScenarioJob( void * pv)
+{
+  ScenarioJob * pjob = static_cast<ScenarioJob *>( pv);
+  pjob->_cSolved = pjob->_psolver->SolveScenariosFrom( *pjob->_psnapshot,
+      *pjob->_pscenarios, *pjob->_pvars, pjob->_values, pjob->_pnext);
+  return NULL;
+}
+
+static int
+ProcessorCount()
+{
+#if !defined( CL_NO_THREADS) && defined( _SC_NPROCESSORS_ONLN)
+  long c = sysconf( _SC_NPROCESSORS_ONLN);
+  return c > 0? int( c) : 1;
+#else
+  return 1;
+#endif
+}
+
+size_t
+SimplexSolver::SolveScenarios( const vector<Scenario> & scenarios,
+                               const vector<Variable> & vars,
+                               Number * values, int cThreads)
 {
 #ifdef CL_TRACE
   Tracer TRACER( __FUNCTION__);
 #endif
+  vector<Scenario>::const_iterator it = scenarios.begin();
+  for ( ; it != scenarios.end(); ++it)
+    {
+    vector<Variable>::const_iterator it_var = (*it)._editVars.begin();
+    for ( ; it_var != (*it)._editVars.end(); ++it_var)
+      {
+      if ( !PEditInfoFromv(*it_var))
+        throw ExCLEditMisuse("SolveScenarios: a scenario suggests a value for a variable that is not being edited");
+      }
+    }
+  if ( scenarios.empty())
+    return 0;
+  if ( cThreads <= 0)
+    cThreads = ProcessorCount();
+  if ( size_t( cThreads) > scenarios.size())
+    cThreads = int( scenarios.size());
+#ifdef CL_NO_THREADS
+  cThreads = 1;
+#endif
+  CatchUpTableau();
+
+  // Each thread gets a copy to solve on and a snapshot to go back to
+  // between scenarios.  They are all made here, since copying a solver
+  // marks its rows shared; after that the threads only share what
+  // none of them changes, apart from reference counts.
+  vector<ScenarioJob> jobs( cThreads);
+  long next = 0;
+  for ( int k = 0; k < cThreads; ++k)
+    {
+    SimplexSolver * psolver = new SimplexSolver( *this);
+    // a failed scenario just gets NaNs, so needs no explanation
+    psolver->_fExplainFailure = false;
+    psolver->_pfnChangevCallback = NULL;
+    psolver->_pfnResolveCallback = NULL;
+    psolver->_pfnCnSatCallback = NULL;
+    psolver->_pfnChangesCallback = NULL;
+    psolver->_fTracksSatisfaction = false;
+    psolver->_ptouchedRows = NULL;
+    psolver->_cRegionCacheLimit = 0;
+    psolver->_regions.clear();
+    ScenarioJob & job = jobs[k];
+    job._psolver = psolver;
+    job._psnapshot = new SimplexSolver( *psolver);
+    job._pscenarios = &scenarios;
+    job._pvars = &vars;
+    job._values = values;
+    job._pnext = &next;
+    job._cSolved = 0;
+    }
 
-  vector<const Point * >::const_iterator it = listOfPoints.begin();
-  double weight = 1.0;
-  static const double multiplier = 2.0;
-  for ( ; it != listOfPoints.end(); ++it )
+#ifndef CL_NO_THREADS
+  // this thread runs the first job; if a thread cannot be started, the
+  // others just take its share
+  vector<pthread_t> threads( cThreads);
+  vector<bool> started( cThreads, false);
+  for ( int k = 1; k < cThreads; ++k)
     {
-    AddPointStay((*it)->X(),(*it)->Y(),strength,weight);
-    weight *= multiplier;
+    started[k] = ( 0 == pthread_create( &threads[k], NULL,
+                                        RunScenarioJob, &jobs[k]));
     }
-  return *this;
-}
+  RunScenarioJob( &jobs[0]);
+  for ( int k = 1; k < cThreads; ++k)
+    {
+    if ( started[k])
+      pthread_join( threads[k], NULL);
+    }
+#else
+  RunScenarioJob( &jobs[0]);
+#endif
 
-SimplexSolver & 
-SimplexSolver::AddPointStay( const Point & clp, const Strength & strength, double weight)
-{ 
-  AddPointStay( clp.X(),clp.Y(),strength,weight);
-  return *this;
+  size_t cSolved = 0;
+  for ( int k = 0; k < cThreads; ++k)
+    {
+    cSolved += jobs[k]._cSolved;
+    delete jobs[k]._psolver;
+    delete jobs[k]._psnapshot;
+    }
+  return cSolved;
 }
 
-
-SimplexSolver & 
-SimplexSolver::RemoveEditVarsTo( int n)
+size_t
+SimplexSolver::SolveScenariosFrom( const SimplexSolver & snapshot,
+                                   const vector<Scenario> & scenarios,
+                                   const vector<Variable> & vars,
+                                   Number * values, long * pnext)
 {
-  queue<Variable> qclv;
-  VarSet sclvStillEditing; // Set of edit variables that we need to * not* remove
-#ifdef DEBUG_NESTED_EDITS
-  cout << __FUNCTION__ << " " << n << endl;
-#endif
-  int i = 0;
-  for ( EditInfoList::const_iterator it = _editInfoList.begin();
-        ( it != _editInfoList.end() && _editInfoList.size() != (unsigned)n);
-        ++it, ++i ) 
-    {
-    P_EditInfo pcei = (*it);
-    assert( pcei);
-#ifdef DEBUG_NESTED_EDITS
-    cout << __FUNCTION__ << "Checking " << pcei->_clv
-         << ", index = " << i << endl;
-#endif
-    if ( i >= n 
-         && pcei->_pconstraint)      //FIX: svd - complementary of 
-                    //::AddConstraint() - adding a partial _editInfoList 
-                    //_editInfoList.push_back( new EditInfo( v, NULL, clvNil, clvNil, 0));
-      qclv.push( pcei->_clv);
-    else
-      sclvStillEditing.insert( pcei->_clv);
-    }
-  while (!qclv.empty()) 
+  size_t cVars = vars.size();
+  size_t cSolved = 0;
+  bool fFresh = true;
+  for ( ; ; )
     {
-    Variable clv = qclv.front();
-    // only remove the variable if it's not in the set of variable
-    // from a previous nested outer edit
-    // e.g., if I do:
-    // Edit x,y
-    // Edit w,h,x,y
-    // EndEdit
-    // The end edit needs to only get rid of the edits on w,h
-    // not the ones on x,y
-    if ( sclvStillEditing.find( clv) == sclvStillEditing.end())
+    long i = ATOMIC_ADD( pnext, 1) - 1;
+    if ( i >= long( scenarios.size()))
+      break;
+    bool fRestore = !fFresh;
+    fFresh = false;
+
+    const Scenario & scenario = scenarios[i];
+    Number * row = values + i * cVars;
+    bool fSolved = false;
+    // an exception must not leave the thread, so anything that goes
+    // wrong, not just an unsatisfiable scenario, only costs this row
+    try
       {
-#ifdef DEBUG_NESTED_EDITS
-      cout << __FUNCTION__ << ": Removing " << clv << endl;
-#endif
-      RemoveEditVar( clv);
+      if ( fRestore)
+        Restore( snapshot);
+      vector<P_Constraint> failed;
+      if ( !scenario._constraints.empty())
+        AddConstraints( scenario._constraints, &failed);
+      if ( failed.empty())
+        {
+        Solve();
+        for ( size_t k = 0; k < scenario._editVars.size(); ++k)
+          {
+          SuggestValue( scenario._editVars[k], scenario._editValues[k]);
+          }
+        if ( !scenario._editVars.empty())
+          Resolve();
+        for ( size_t j = 0; j < cVars; ++j)
+          {
+          row[j] = ValueOf( vars[j]);
+          }
+        fSolved = true;
+        }
       }
-#ifdef DEBUG_NESTED_EDITS
+    catch ( ... )
+      {
+      }
+
+    if ( fSolved)
+      ++cSolved;
     else
       {
-      cout << __FUNCTION__ << ": Not removing " << clv << endl;
+      for ( size_t j = 0; j < cVars; ++j)
+        {
+        row[j] = numeric_limits<Number>::quiet_NaN();
+        }
       }
-#endif
-    qclv.pop();
     }
-  while ( _editInfoList.size() > (unsigned)n) {
-    _editInfoList.pop_back();
-  }
-  
-  return *this;
+  return cSolved;
 }
 
-
-/* A predicate used for remove_if */
-class VarInVarSet : public unary_function<Variable,bool> {
-public:
-  VarInVarSet( const VarSet & clvset) : 
-      _set( clvset),
-      _setEnd( const_cast<VarSet &>(clvset).end() ) 
+struct SimplexSolver::SnapSearch {
+  SnapSearch( const vector<Variable> & vars, Number grid, int cTrialsMax)
+      : _vars( vars), _grid( grid), _cTrialsLeft( cTrialsMax), _cBest( -1)
     { }
 
-  bool operator ()( const Variable & clv) const {
-    return ( _set.find( clv) != _setEnd);
-  }
-  
-private:
-  const VarSet & _set;
-  const VarSet::iterator _setEnd;
+  const vector<Variable> & _vars;
+  Number _grid;
+  int _cTrialsLeft;
+  // the most vars snapped, and the external variables' values then
+  int _cBest;
+  vector<pair<Variable, Number> > _values;
 };
 
-
-
-// Remove the constraint cn from the tableau
-// Also remove any error variable associated with cn
-SimplexSolver & 
-SimplexSolver::RemoveConstraintInternal( P_Constraint pcn)
+int
+SimplexSolver::SnapToGrid( const vector<Variable> & vars, Number grid,
+                           int cTrialsMax)
 {
 #ifdef CL_TRACE
   Tracer TRACER( __FUNCTION__);
-  cout << "(" << * pcn << ")" << endl;
 #endif
+  assert( grid > 0.0);
+  if ( _fNeedsSolving)
+    Solve();
+  CatchUpTableau();
+  // search from the tableau's solution, not the last snapped values
+  _snappedValues.clear();
+  // the trials are optimized as they are added ( in SnapFrom), without
+  // setting the variables, and rolled back
+  bool fAutosolve = _fAutosolve;
+  _fAutosolve = false;
+  SnapSearch search( vars, grid, cTrialsMax);
+  BeginTransaction();
+  try
+    {
+    SnapFrom( search, 0, 0);
+    }
+  catch ( ... )
+    {
+    RollbackTransaction();
+    _fAutosolve = fAutosolve;
+    throw;
+    }
+  RollbackTransaction();
+  _fAutosolve = fAutosolve;
 
-  // We are about to remove a constraint.  There may be some stay
-  // constraints that were unsatisfied previously -- if we just
-  // removed the constraint these could come into play.  Instead,
-  // Reset all of the stays so that things should stay where they are
-  // at the moment.
-  _fNeedsSolving = true;
-
-  ResetStayConstants();
-
-  // remove any error variables from the objective function
+  ++_cSolutions;
+  _changedVars.clear();
+  vector<pair<Variable, Number> >::const_iterator it = search._values.begin();
+  for ( ; it != search._values.end(); ++it)
+    {
+    _snappedValues[(*it).first] = (*it).second;
+    Changev( (*it).first, (*it).second);
+    }
+  // the values are no longer the tableau's
+  _fExternalValuesInSync = false;
+  _editedExternalRows.clear();
+  if ( _pfnChangesCallback && !_changedVars.empty())
+    _pfnChangesCallback( this, _changedVars);
+  if ( _pfnResolveCallback)
+    _pfnResolveCallback( this);
+  return search._cBest;
+}
+
+void
+SimplexSolver::SnapFrom( SnapSearch & search, size_t i, int cSnapped)
+{
+  const vector<Variable> & vars = search._vars;
+  // bound: snapping all the rest would not beat the best
+  if ( cSnapped + int( vars.size() - i) <= search._cBest)
+    return;
+  if ( i == vars.size())
+    {
+    search._cBest = cSnapped;
+    search._values.clear();
+    VarSet::const_iterator it = _externalParametricVars.begin();
+    for ( ; it != _externalParametricVars.end(); ++it)
+      search._values.push_back( make_pair(*it, 0.0));
+    for ( it = _externalRows.begin(); it != _externalRows.end(); ++it)
+      search._values.push_back( make_pair(*it, ConstRowExpression(*it)->Constant()));
+    return;
+    }
+
+  const Variable & v = vars[i];
+  if ( ColumnsHasKey( v) || FIsBasicVar( v))
+    {
+    Number x = ValueOf( v);
+    Number below = floor( x / search._grid) * search._grid;
+    Number above = below + search._grid;
+    Number candidates[2];
+    candidates[0] = ( x - below <= above - x)? below : above;
+    candidates[1] = ( candidates[0] == below)? above : below;
+    for ( int k = 0; k < 2 && search._cTrialsLeft > 0; ++k)
+      {
+      --search._cTrialsLeft;
+      BeginTransaction();
+      if ( TryAddConstraint( new LinearEquation( v, candidates[k])) == clsOk)
+        {
+        Optimize( _objective);
+        SnapFrom( search, i + 1, cSnapped + 1);
+        }
+      RollbackTransaction();
+      if ( search._cBest == int( vars.size()))
+        return;
+      }
+    }
+  // leave v alone
+  SnapFrom( search, i + 1, cSnapped);
+}
+
+// The solver file format ( see Save()): four magic bytes and the
+// version; the tables of the strengths, variables and constraints
+// that the rest refers to by index; then the solver's state, as
+// SaveState() writes it.  Counts, indices and other integers take 4
+// bytes and doubles 8, both little-endian; flags and kinds take 1.
+static const char rgchSolverFileMagic[] = { 'C', 'L', 'S', 'V' };
+// ( Version 2 has the implicit stays, which were taken out again.)
+static const unsigned int nSolverFileVersion = 3;
+static const unsigned int iNil = 0xffffffff;
+
+enum SolverFileVarKind { sfvFloat, sfvSlack, sfvDummy, sfvObjective };
+enum SolverFileCnKind { sfcEquation, sfcInequality, sfcEdit, sfcStay };
+
+static bool
+FIsLittleEndian()
+{
+  unsigned int n = 1;
+  return *reinterpret_cast<unsigned char * >(&n) == 1;
+}
+
+static void
+AppendIndex( string & s, unsigned int n)
+{
+  for ( int i = 0; i < 4; ++i, n >>= 8)
+    s += char( n & 0xff);
+}
+
+static void
+AppendNumber( string & s, Number x)
+{
+  unsigned char rgb[sizeof( Number)];
+  memcpy( rgb, &x, sizeof( Number));
+  if ( !FIsLittleEndian())
+    reverse( rgb, rgb + sizeof( Number));
+  s.append( reinterpret_cast<const char * >( rgb), sizeof( Number));
+}
+
+static void
+AppendString( string & s, const string & str)
+{
+  AppendIndex( s, str.size());
+  s += str;
+}
+
+// Writes a solver's state for Save().  The Put functions append to
+// the body; the strengths, variables and constraints they are given
+// are numbered in the order they are first seen, and described in
+// their tables then.
+class SolverSaver {
+public:
+  void PutFlag( bool f)
+    { _body += char( f? 1 : 0); }
+  void PutIndex( unsigned int n)
+    { AppendIndex( _body, n); }
+  void PutNumber( Number x)
+    { AppendNumber( _body, x); }
+  void PutString( const string & s)
+    { AppendString( _body, s); }
+  void PutVar( const Variable & v)
+    { PutIndex( VarIndex( v)); }
+  void PutConstraint( P_Constraint pcn)
+    { PutIndex( ConstraintIndex( pcn)); }
+  void PutExpression( const LinearExpression & expr)
+    { AppendExpression( _body, expr); }
+
+  // a count, then the variables in vars
+  template <class Vars>
+  void PutVars( const Vars & vars)
+    {
+    PutIndex( vars.size());
+    typename Vars::const_iterator it = vars.begin();
+    for ( ; it != vars.end(); ++it)
+      PutVar( *it);
+    }
+
+  // Put the header, the tables and the body together in bytes
+  void Finish( string & bytes, VarVector * pExternals,
+               vector<P_Constraint> * pConstraints) const;
+
+private:
+  unsigned int VarIndex( const Variable & v);
+  unsigned int StrengthIndex( const Strength & strength);
+  unsigned int ConstraintIndex( P_Constraint pcn);
+  void AppendExpression( string & s, const LinearExpression & expr);
+
+  string _body;
+  string _strengthTable;
+  string _varTable;
+  string _cnTable;
+  vector<Strength> _strengths;
+  VarVector _vars;
+  map<const AbstractVariable *, unsigned int> _varIndexes;
+  vector<P_Constraint> _cns;
+  map<const Constraint *, unsigned int> _cnIndexes;
+};
+
+unsigned int
+SolverSaver::VarIndex( const Variable & v)
+{
+  if ( v.IsNil())
+    return iNil;
+  map<const AbstractVariable *, unsigned int>::iterator it = _varIndexes.find( v.get_pclv());
+  if ( it != _varIndexes.end())
+    return (*it).second;
+
+  unsigned char kind;
+  if ( v.IsFDVariable())
+    throw ExCLSolverFileError( "Cannot save the FD variable " + v.Name());
+  else if ( v.IsFloatVariable())
+    kind = sfvFloat;
+  else if ( v.IsDummy())
+    kind = sfvDummy;
+  else if ( v.IsRestricted())
+    kind = sfvSlack;
+  else
+    kind = sfvObjective;
+
+  unsigned int i = _vars.size();
+  _varIndexes[v.get_pclv()] = i;
+  _vars.push_back( v);
+  _varTable += char( kind);
+  AppendString( _varTable, v.Name());
+  if ( kind == sfvFloat)
+    AppendNumber( _varTable, v.Value());
+  return i;
+}
+
+unsigned int
+SolverSaver::StrengthIndex( const Strength & strength)
+{
+  for ( unsigned int i = 0; i < _strengths.size(); ++i)
+    {
+    if ( _strengths[i].Name() == strength.Name() &&
+         _strengths[i].IsRequired() == strength.IsRequired() &&
+         _strengths[i].symbolicWeight() == strength.symbolicWeight())
+      return i;
+    }
+  _strengths.push_back( strength);
+  AppendString( _strengthTable, strength.Name());
+  _strengthTable += char( strength.IsRequired()? 1 : 0);
+  const vector<Number> & values = strength.symbolicWeight().Values();
+  AppendIndex( _strengthTable, values.size());
+  for ( size_t i = 0; i < values.size(); ++i)
+    AppendNumber( _strengthTable, values[i]);
+  return _strengths.size() - 1;
+}
+
+unsigned int
+SolverSaver::ConstraintIndex( P_Constraint pcn)
+{
+  if ( !pcn)
+    return iNil;
+  map<const Constraint *, unsigned int>::iterator it = _cnIndexes.find( pcn.ptr());
+  if ( it != _cnIndexes.end())
+    return (*it).second;
+
+  unsigned char kind;
+  if ( pcn->IsEditConstraint())
+    kind = sfcEdit;
+  else if ( pcn->isStayConstraint())
+    kind = sfcStay;
+  else if ( pcn->IsStrictInequality() || !dynamic_cast<LinearConstraint * >( pcn.ptr()))
+    throw ExCLSolverFileError( "Cannot save a constraint of this kind");
+  else if ( pcn->IsInequality())
+    kind = sfcInequality;
+  else
+    kind = sfcEquation;
+
+  unsigned int i = _cns.size();
+  _cnIndexes[pcn.ptr()] = i;
+  _cns.push_back( pcn);
+  _cnTable += char( kind);
+  AppendIndex( _cnTable, StrengthIndex( pcn->strength()));
+  AppendNumber( _cnTable, pcn->weight());
+  if ( kind == sfcEdit || kind == sfcStay)
+    {
+    EditOrStayConstraint * pcnEditOrStay = dynamic_cast<EditOrStayConstraint * >( pcn.ptr());
+    AppendIndex( _cnTable, VarIndex( pcnEditOrStay->variable()));
+    }
+  else
+    {
+    AppendExpression( _cnTable, pcn->Expression());
+    }
+  const VarSet & readOnlyVars = pcn->ReadOnlyVars();
+  AppendIndex( _cnTable, readOnlyVars.size());
+  VarSet::const_iterator it_ro = readOnlyVars.begin();
+  for ( ; it_ro != readOnlyVars.end(); ++it_ro)
+    AppendIndex( _cnTable, VarIndex( *it_ro));
+  return i;
+}
+
+void
+SolverSaver::AppendExpression( string & s, const LinearExpression & expr)
+{
+  AppendNumber( s, expr.Constant());
+  AppendIndex( s, expr.Terms().size());
+  VarToNumberMap::const_iterator it = expr.Terms().begin();
+  for ( ; it != expr.Terms().end(); ++it)
+    {
+    AppendIndex( s, VarIndex( (*it).first));
+    AppendNumber( s, (*it).second);
+    }
+}
+
+void
+SolverSaver::Finish( string & bytes, VarVector * pExternals,
+                     vector<P_Constraint> * pConstraints) const
+{
+  bytes.assign( rgchSolverFileMagic, sizeof( rgchSolverFileMagic));
+  AppendIndex( bytes, nSolverFileVersion);
+  bytes.reserve( bytes.size() + 12 + _strengthTable.size() + _varTable.size() +
+                 _cnTable.size() + _body.size());
+  AppendIndex( bytes, _strengths.size());
+  bytes += _strengthTable;
+  AppendIndex( bytes, _vars.size());
+  bytes += _varTable;
+  AppendIndex( bytes, _cns.size());
+  bytes += _cnTable;
+  bytes += _body;
+
+  if ( pExternals)
+    {
+    for ( size_t i = 0; i < _vars.size(); ++i)
+      {
+      if ( _vars[i].IsFloatVariable())
+        pExternals->push_back( _vars[i]);
+      }
+    }
+  if ( pConstraints)
+    pConstraints->insert( pConstraints->end(), _cns.begin(), _cns.end());
+}
+
+// Reads what SolverSaver wrote, in place, for Load().  Throws
+// ExCLSolverFileError on anything that does not fit the format.
+class SolverLoader {
+public:
+  SolverLoader( const char * pb, size_t cb)
+      : _pb( reinterpret_cast<const unsigned char * >( pb)), _pbLim( _pb + cb)
+    { }
+
+  bool GetFlag()
+    { Need( 1); return *_pb++ != 0; }
+
+  unsigned int GetIndex()
+    {
+    Need( 4);
+    unsigned int n = _pb[0] | ( _pb[1] << 8) | ( _pb[2] << 16) | 
+                     ( (unsigned int) _pb[3] << 24);
+    _pb += 4;
+    return n;
+    }
+
+  // a count of items of at least cbItem bytes each, which have to fit
+  // in what is left
+  size_t GetCount( size_t cbItem)
+    {
+    size_t c = GetIndex();
+    if ( cbItem > 0 && c > size_t( _pbLim - _pb) / cbItem)
+      throw ExCLSolverFileError( "A count is larger than the data");
+    return c;
+    }
+
+  Number GetNumber()
+    {
+    Need( sizeof( Number));
+    unsigned char rgb[sizeof( Number)];
+    memcpy( rgb, _pb, sizeof( Number));
+    if ( !FIsLittleEndian())
+      reverse( rgb, rgb + sizeof( Number));
+    _pb += sizeof( Number);
+    Number x;
+    memcpy( &x, rgb, sizeof( Number));
+    return x;
+    }
+
+  string GetString()
+    {
+    size_t cch = GetCount( 1);
+    string s( reinterpret_cast<const char * >( _pb), cch);
+    _pb += cch;
+    return s;
+    }
+
+  Variable GetVar()
+    {
+    unsigned int i = GetIndex();
+    if ( i == iNil)
+      return clvNil;
+    if ( i >= _vars.size())
+      throw ExCLSolverFileError( "No such variable");
+    return _vars[i];
+    }
+
+  // As GetVar(), but nil is not allowed
+  Variable GetSomeVar()
+    {
+    Variable v = GetVar();
+    if ( v.IsNil())
+      throw ExCLSolverFileError( "Missing variable");
+    return v;
+    }
+
+  P_Constraint GetConstraint()
+    {
+    unsigned int i = GetIndex();
+    if ( i == iNil)
+      return NULL;
+    if ( i >= _cns.size())
+      throw ExCLSolverFileError( "No such constraint");
+    return _cns[i];
+    }
+
+  // As GetConstraint(), but nil is not allowed
+  P_Constraint GetSomeConstraint()
+    {
+    P_Constraint pcn = GetConstraint();
+    if ( !pcn)
+      throw ExCLSolverFileError( "Missing constraint");
+    return pcn;
+    }
+
+  void GetExpression( LinearExpression & expr);
+
+  void GetVars( VarSet & vars)
+    {
+    for ( size_t c = GetCount( 4); c > 0; --c)
+      vars.insert( GetSomeVar());
+    }
+
+  void GetVars( VarVector & vars)
+    {
+    for ( size_t c = GetCount( 4); c > 0; --c)
+      vars.push_back( GetSomeVar());
+    }
+
+  bool FAtEnd() const
+    { return _pb == _pbLim; }
+
+  // Read the header and the tables, binding the external variables and
+  // constraints given
+  void GetTables( const VarVector * pBindVars, const vector<P_Constraint> * pBindCns);
+
+  // Give the bound external variables their saved values, once the
+  // whole solver has been read, so that a load that fails leaves them
+  // alone
+  void SetBoundValues() const;
+
+  // The external variables and the constraints, as bound or made
+  void GetResults( VarVector * pExternals, vector<P_Constraint> * pConstraints) const;
+
+private:
+  void Need( size_t cb) const
+    {
+    if ( size_t( _pbLim - _pb) < cb)
+      throw ExCLSolverFileError( "The data ends too soon");
+    }
+
+  const unsigned char * _pb;
+  const unsigned char * _pbLim;
+  vector<Strength> _strengths;
+  VarVector _vars;
+  vector<P_Constraint> _cns;
+  // the bound external variables and their saved values
+  vector<pair<Variable, Number> > _boundValues;
+};
+
+void
+SolverLoader::GetExpression( LinearExpression & expr)
+{
+  expr.Set_constant( GetNumber());
+  for ( size_t c = GetCount( 12); c > 0; --c)
+    {
+    Variable v = GetSomeVar();
+    expr.Terms()[v] = GetNumber();
+    }
+}
+
+void
+SolverLoader::GetTables( const VarVector * pBindVars, const vector<P_Constraint> * pBindCns)
+{
+  Need( sizeof( rgchSolverFileMagic));
+  if ( memcmp( _pb, rgchSolverFileMagic, sizeof( rgchSolverFileMagic)) != 0)
+    throw ExCLSolverFileError( "Not a saved solver");
+  _pb += sizeof( rgchSolverFileMagic);
+  if ( GetIndex() != nSolverFileVersion)
+    throw ExCLSolverFileError( "Unknown version of the format");
+
+  for ( size_t c = GetCount( 9); c > 0; --c)
+    {
+    string name = GetString();
+    bool fRequired = GetFlag();
+    vector<Number> values( GetCount( sizeof( Number)));
+    for ( size_t i = 0; i < values.size(); ++i)
+      values[i] = GetNumber();
+    _strengths.push_back( Strength( name, SymbolicWeight( values), fRequired));
+    }
+
+  size_t iExternal = 0;
+  for ( size_t c = GetCount( 5); c > 0; --c)
+    {
+    Need( 1);
+    unsigned char kind = *_pb++;
+    string name = GetString();
+    switch ( kind)
+      {
+      case sfvFloat:
+        {
+        Number value = GetNumber();
+        if ( pBindVars && iExternal < pBindVars->size() &&
+             !(*pBindVars)[iExternal].IsNil())
+          {
+          Variable v = (*pBindVars)[iExternal];
+          if ( !v.IsFloatVariable())
+            throw ExCLSolverFileError( "Cannot bind " + v.Name() + ", which is not a float variable");
+          _boundValues.push_back( make_pair( v, value));
+          _vars.push_back( v);
+          }
+        else
+          {
+          _vars.push_back( Variable( new FloatVariable( name, value)));
+          }
+        ++iExternal;
+        break;
+        }
+      case sfvSlack:
+        _vars.push_back( Variable( new SlackVariable( name)));
+        break;
+      case sfvDummy:
+        _vars.push_back( Variable( new DummyVariable( name)));
+        break;
+      case sfvObjective:
+        _vars.push_back( Variable( new ObjectiveVariable( name)));
+        break;
+      default:
+        throw ExCLSolverFileError( "Unknown kind of variable");
+      }
+    }
+  if ( pBindVars && pBindVars->size() > iExternal)
+    throw ExCLSolverFileError( "More variables to bind than were saved");
+
+  for ( size_t c = GetCount( 21); c > 0; --c)
+    {
+    Need( 1);
+    unsigned char kind = *_pb++;
+    unsigned int iStrength = GetIndex();
+    if ( iStrength >= _strengths.size())
+      throw ExCLSolverFileError( "No such strength");
+    const Strength & strength = _strengths[iStrength];
+    Number weight = GetNumber();
+    P_Constraint pcn;
+    switch ( kind)
+      {
+      case sfcEdit:
+        pcn = new EditConstraint( GetSomeVar(), strength, weight);
+        break;
+      case sfcStay:
+        pcn = new StayConstraint( GetSomeVar(), strength, weight);
+        break;
+      case sfcEquation:
+      case sfcInequality:
+        {
+        LinearExpression expr;
+        GetExpression( expr);
+        if ( kind == sfcEquation)
+          pcn = new LinearEquation( expr, strength, weight);
+        else
+          pcn = new LinearInequality( expr, strength, weight);
+        break;
+        }
+      default:
+        throw ExCLSolverFileError( "Unknown kind of constraint");
+      }
+    VarSet readOnlyVars;
+    GetVars( readOnlyVars);
+    pcn->AddROVars( readOnlyVars);
+
+    size_t i = _cns.size();
+    if ( pBindCns && i < pBindCns->size() && (*pBindCns)[i])
+      {
+      P_Constraint pcnBound = (*pBindCns)[i];
+      if ( !pcnBound->FIsStructurallyEqual( *pcn))
+        throw ExCLSolverFileError( "A constraint to bind is not the one saved");
+      pcn = pcnBound;
+      }
+    _cns.push_back( pcn);
+    }
+  if ( pBindCns && pBindCns->size() > _cns.size())
+    throw ExCLSolverFileError( "More constraints to bind than were saved");
+}
+
+void
+SolverLoader::SetBoundValues() const
+{
+  vector<pair<Variable, Number> >::const_iterator it = _boundValues.begin();
+  for ( ; it != _boundValues.end(); ++it)
+    {
+    Variable v = (*it).first;
+    v.ChangeValue( (*it).second);
+    }
+}
+
+void
+SolverLoader::GetResults( VarVector * pExternals, vector<P_Constraint> * pConstraints) const
+{
+  if ( pExternals)
+    {
+    for ( size_t i = 0; i < _vars.size(); ++i)
+      {
+      if ( _vars[i].IsFloatVariable())
+        pExternals->push_back( _vars[i]);
+      }
+    }
+  if ( pConstraints)
+    pConstraints->insert( pConstraints->end(), _cns.begin(), _cns.end());
+}
+
+void
+SimplexSolver::Save( string & bytes, VarVector * pExternals,
+                     vector<P_Constraint> * pConstraints) const
+{
+  SolverSaver saver;
+  SaveState( saver);
+  saver.Finish( bytes, pExternals, pConstraints);
+}
+
+void
+SimplexSolver::SaveFile( const char * path, VarVector * pExternals,
+                         vector<P_Constraint> * pConstraints) const
+{
+  string bytes;
+  Save( bytes, pExternals, pConstraints);
+  FILE * pf = fopen( path, "wb");
+  if ( !pf)
+    throw ExCLSolverFileError( string( "Cannot open ") + path);
+  bool fOk = fwrite( bytes.data(), 1, bytes.size(), pf) == bytes.size();
+  fOk = ( fclose( pf) == 0) && fOk;
+  if ( !fOk)
+    throw ExCLSolverFileError( string( "Cannot write ") + path);
+}
+
+SimplexSolver *
+SimplexSolver::Load( const char * pb, size_t cb,
+                     const VarVector * pBindVars,
+                     const vector<P_Constraint> * pBindCns,
+                     VarVector * pExternals,
+                     vector<P_Constraint> * pConstraints)
+{
+  SolverLoader loader( pb, cb);
+  loader.GetTables( pBindVars, pBindCns);
+  SimplexSolver * psolver = new SimplexSolver();
+  try
+    {
+    psolver->LoadState( loader);
+    if ( !loader.FAtEnd())
+      throw ExCLSolverFileError( "Data left over after the solver");
+    }
+  catch ( ... )
+    {
+    delete psolver;
+    throw;
+    }
+  loader.SetBoundValues();
+  loader.GetResults( pExternals, pConstraints);
+  return psolver;
+}
+
+SimplexSolver *
+SimplexSolver::LoadFile( const char * path,
+                         const VarVector * pBindVars,
+                         const vector<P_Constraint> * pBindCns,
+                         VarVector * pExternals,
+                         vector<P_Constraint> * pConstraints)
+{
+#ifndef CL_NO_MMAP
+  int fd = open( path, O_RDONLY);
+  if ( fd < 0)
+    throw ExCLSolverFileError( string( "Cannot open ") + path);
+  struct stat st;
+  if ( fstat( fd, &st) != 0 || st.st_size == 0)
+    {
+    close( fd);
+    throw ExCLSolverFileError( string( "Cannot read ") + path);
+    }
+  size_t cb = st.st_size;
+  void * pv = mmap( NULL, cb, PROT_READ, MAP_PRIVATE, fd, 0);
+  close( fd);
+  if ( pv == MAP_FAILED)
+    throw ExCLSolverFileError( string( "Cannot map ") + path);
+  SimplexSolver * psolver;
+  try
+    {
+    psolver = Load( static_cast<const char * >( pv), cb,
+                    pBindVars, pBindCns, pExternals, pConstraints);
+    }
+  catch ( ... )
+    {
+    munmap( pv, cb);
+    throw;
+    }
+  munmap( pv, cb);
+  return psolver;
+#else
+  FILE * pf = fopen( path, "rb");
+  if ( !pf)
+    throw ExCLSolverFileError( string( "Cannot open ") + path);
+  string bytes;
+  char rgch[8192];
+  size_t cch;
+  while ( ( cch = fread( rgch, 1, sizeof( rgch), pf)) > 0)
+    bytes.append( rgch, cch);
+  bool fOk = !ferror( pf);
+  fclose( pf);
+  if ( !fOk)
+    throw ExCLSolverFileError( string( "Cannot read ") + path);
+  return Load( bytes.data(), bytes.size(),
+               pBindVars, pBindCns, pExternals, pConstraints);
+#endif
+}
+
+// The state in the order LoadState() reads it back.  Members that
+// are rebuilt from others ( the columns, the external row and
+// parametric sets, the fingerprint) or are caches are left out.
+void
+SimplexSolver::SaveState( SolverSaver & saver) const
+{
+  saver.PutVar( _objective);
+  saver.PutIndex( _rows.size());
+  TableauRowsMap::const_iterator it_row = _rows.begin();
+  for ( ; it_row != _rows.end(); ++it_row)
+    {
+    saver.PutVar( (*it_row).first);
+    saver.PutExpression( *(*it_row).second);
+    }
+  saver.PutVars( _infeasibleRows);
+
+  saver.PutVars( _stayMinusErrorVars);
+  saver.PutVars( _stayPlusErrorVars);
+  saver.PutIndex( _errorVars.size());
+  ConstraintToVarSetMap::const_iterator it_err = _errorVars.begin();
+  for ( ; it_err != _errorVars.end(); ++it_err)
+    {
+    saver.PutConstraint( (*it_err).first);
+    saver.PutVars( (*it_err).second);
+    saver.PutNumber( ErrorWeight( (*it_err).first));
+    }
+  saver.PutIndex( _markerVars.size());
+  ConstraintToVarMap::const_iterator it_marker = _markerVars.begin();
+  for ( ; it_marker != _markerVars.end(); ++it_marker)
+    {
+    saver.PutConstraint( (*it_marker).first);
+    saver.PutVar( (*it_marker).second);
+    }
+  saver.PutIndex( _constraintsMarked.size());
+  VarToConstraintMap::const_iterator it_marked = _constraintsMarked.begin();
+  for ( ; it_marked != _constraintsMarked.end(); ++it_marked)
+    {
+    saver.PutVar( (*it_marked).first);
+    saver.PutConstraint( (*it_marked).second);
+    }
+
+  // the edit entries, those in _editInfoList in order and then the
+  // parked slots, which the index and the slots refer to by position
+  vector<P_EditInfo> entries( _editInfoList.begin(), _editInfoList.end());
+  size_t cInList = entries.size();
+  map<const EditInfo *, unsigned int> positions;
+  for ( size_t i = 0; i < entries.size(); ++i)
+    positions[entries[i].ptr()] = i;
+  VarToEditInfoMap::const_iterator it_map = _editSlots.begin();
+  for ( ; it_map != _editSlots.end(); ++it_map)
+    {
+    if ( positions.find( (*it_map).second.ptr()) == positions.end())
+      {
+      positions[(*it_map).second.ptr()] = entries.size();
+      entries.push_back( (*it_map).second);
+      }
+    }
+  saver.PutIndex( cInList);
+  saver.PutIndex( entries.size() - cInList);
+  for ( size_t i = 0; i < entries.size(); ++i)
+    {
+    const EditInfo & cei = *entries[i];
+    saver.PutVar( cei._clv);
+    saver.PutConstraint( cei._pconstraint);
+    saver.PutVar( cei._clvEditPlus);
+    saver.PutVar( cei._clvEditMinus);
+    saver.PutNumber( cei._prevEditConstant);
+    saver.PutNumber( cei._errorWeight);
+    saver.PutFlag( cei._fInUse);
+    }
+  saver.PutIndex( _editInfoMap.size());
+  for ( it_map = _editInfoMap.begin(); it_map != _editInfoMap.end(); ++it_map)
+    {
+    saver.PutVar( (*it_map).first);
+    saver.PutIndex( positions[(*it_map).second.ptr()]);
+    }
+  saver.PutIndex( _editSlots.size());
+  for ( it_map = _editSlots.begin(); it_map != _editSlots.end(); ++it_map)
+    {
+    saver.PutVar( (*it_map).first);
+    saver.PutIndex( positions[(*it_map).second.ptr()]);
+    }
+
+  saver.PutIndex( _stayConstraints.size());
+  VarToConstraintSetMap::const_iterator it_stays = _stayConstraints.begin();
+  for ( ; it_stays != _stayConstraints.end(); ++it_stays)
+    {
+    saver.PutVar( (*it_stays).first);
+    saver.PutIndex( (*it_stays).second.size());
+    ConstraintSet::const_iterator it_cn = (*it_stays).second.begin();
+    for ( ; it_cn != (*it_stays).second.end(); ++it_cn)
+      saver.PutConstraint( *it_cn);
+    }
+  saver.PutIndex( _varUseCounts.size());
+  VarToIntMap::const_iterator it_use = _varUseCounts.begin();
+  for ( ; it_use != _varUseCounts.end(); ++it_use)
+    {
+    saver.PutVar( (*it_use).first);
+    saver.PutIndex( (*it_use).second);
+    }
+  saver.PutVars( _unusedVarCandidates);
+
+  saver.PutIndex( _groups.size());
+  ConstraintGroupMap::const_iterator it_group = _groups.begin();
+  for ( ; it_group != _groups.end(); ++it_group)
+    {
+    saver.PutString( (*it_group).first);
+    saver.PutFlag( (*it_group).second._fActive);
+    const vector<P_Constraint> & cns = (*it_group).second._constraints;
+    saver.PutIndex( cns.size());
+    for ( size_t i = 0; i < cns.size(); ++i)
+      saver.PutConstraint( cns[i]);
+    }
+  saver.PutIndex( _preparedConstraints.size());
+  PreparedConstraintMap::const_iterator it_prep = _preparedConstraints.begin();
+  for ( ; it_prep != _preparedConstraints.end(); ++it_prep)
+    {
+    const PreparedConstraint & prep = (*it_prep).second;
+    saver.PutConstraint( (*it_prep).first);
+    saver.PutString( prep._group);
+    saver.PutExpression( prep._expression);
+    saver.PutVar( prep._clvMarker);
+    saver.PutVar( prep._clvEminus);
+    saver.PutFlag( prep._fRequired);
+    }
+
+  saver.PutIndex( _slackCounter);
+  saver.PutIndex( _artificialCounter);
+  saver.PutIndex( _dummyCounter);
+  saver.PutFlag( _fAutosolve);
+  saver.PutFlag( _fResetStayConstantsAutomatically);
+  saver.PutFlag( _fRemoveUnusedVariablesAutomatically);
+  saver.PutFlag( _fNeedsSolving);
+  saver.PutFlag( _fExternalValuesInSync);
+  saver.PutFlag( _fExplainFailure);
+  saver.PutFlag( _fMinimalExplanations);
+  saver.PutFlag( _fWritesVariables);
+  saver.PutFlag( _fTableauBehind);
+  saver.PutVars( _editedExternalRows);
+  saver.PutIndex( _cRegionCacheLimit);
+  saver.PutIndex( _cBasisCacheLimit);
+
+  // the edit counts of the BeginEdit()s, from the bottom of the stack
+  stack<int> stkCedcns = _stkCedcns;
+  vector<int> cedcns;
+  for ( ; !stkCedcns.empty(); stkCedcns.pop())
+    cedcns.push_back( stkCedcns.top());
+  saver.PutIndex( cedcns.size());
+  for ( size_t i = cedcns.size(); i > 0; --i)
+    saver.PutIndex( cedcns[i - 1]);
+}
+
+void
+SimplexSolver::LoadState( SolverLoader & loader)
+{
+  _rows.clear();
+  _objective = loader.GetSomeVar();
+  for ( size_t c = loader.GetCount( 16); c > 0; --c)
+    {
+    Variable v = loader.GetSomeVar();
+    P_LinearExpression pexpr = new LinearExpression();
+    loader.GetExpression( *pexpr);
+    addRow( v, pexpr);
+    }
+  if ( !RowExpression( _objective))
+    throw ExCLSolverFileError( "The objective has no row");
+  // addRow() took any variable that was not yet basic for parametric
+  _externalParametricVars.clear();
+  TableauColumnsMap::const_iterator it_col = _columns.begin();
+  for ( ; it_col != _columns.end(); ++it_col)
+    {
+    const Variable & v = (*it_col).first;
+    if ( v.IsExternal() && !FIsBasicVar( v))
+      _externalParametricVars.insert( v);
+    }
+  loader.GetVars( _infeasibleRows);
+
+  loader.GetVars( _stayMinusErrorVars);
+  loader.GetVars( _stayPlusErrorVars);
+  for ( size_t c = loader.GetCount( 16); c > 0; --c)
+    {
+    P_Constraint pcn = loader.GetSomeConstraint();
+    loader.GetVars( _errorVars[pcn]);
+    Number weight = loader.GetNumber();
+    if ( !pcn->IsEditConstraint())
+      _errorWeights[pcn] = weight;
+    }
+  for ( size_t c = loader.GetCount( 8); c > 0; --c)
+    {
+    P_Constraint pcn = loader.GetSomeConstraint();
+    Variable v = loader.GetSomeVar();
+    if ( _markerVars.find( pcn) != _markerVars.end())
+      throw ExCLSolverFileError( "Bad marker variable");
+    _markerVars[pcn] = v;
+    pcn->addedTo( *this);
+    }
+  for ( size_t c = loader.GetCount( 8); c > 0; --c)
+    {
+    Variable v = loader.GetSomeVar();
+    _constraintsMarked[v] = loader.GetSomeConstraint();
+    }
+
+  size_t cInList = loader.GetIndex();
+  size_t cEntries = cInList + loader.GetIndex();
+  vector<P_EditInfo> entries;
+  for ( size_t i = 0; i < cEntries; ++i)
+    {
+    Variable v = loader.GetSomeVar();
+    P_Constraint pcn = loader.GetConstraint();
+    EditConstraint * pcnEdit = pcn? dynamic_cast<EditConstraint * >( pcn.ptr()) : NULL;
+    if ( pcn && !pcnEdit)
+      throw ExCLSolverFileError( "An edit is not for an edit constraint");
+    Variable clvEplus = loader.GetVar();
+    Variable clvEminus = loader.GetVar();
+    Number prevEditConstant = loader.GetNumber();
+    P_EditInfo pcei = new EditInfo( v, pcnEdit, clvEplus, clvEminus, prevEditConstant);
+    pcei->_errorWeight = loader.GetNumber();
+    pcei->_fInUse = loader.GetFlag();
+    if ( i < cInList)
+      pcei->_itList = _editInfoList.insert( _editInfoList.end(), pcei);
+    entries.push_back( pcei);
+    }
+  for ( int iMap = 0; iMap < 2; ++iMap)
+    {
+    VarToEditInfoMap & edits = ( iMap == 0)? _editInfoMap : _editSlots;
+    for ( size_t c = loader.GetCount( 8); c > 0; --c)
+      {
+      Variable v = loader.GetSomeVar();
+      size_t i = loader.GetIndex();
+      if ( i >= entries.size())
+        throw ExCLSolverFileError( "No such edit");
+      edits[v] = entries[i];
+      }
+    }
+  // ( the edit entries hold the weights of the edit constraints; the
+  // ones saved with their error variables are the same)
+  ConstraintToVarMap::const_iterator it_marker = _markerVars.begin();
+  for ( ; it_marker != _markerVars.end(); ++it_marker)
+    {
+    _activeFingerprint += FingerprintTerm( (*it_marker).second, ErrorWeight( (*it_marker).first));
+    }
+
+  for ( size_t c = loader.GetCount( 8); c > 0; --c)
+    {
+    ConstraintSet & stays = _stayConstraints[loader.GetSomeVar()];
+    for ( size_t cStays = loader.GetCount( 4); cStays > 0; --cStays)
+      stays.insert( loader.GetSomeConstraint());
+    }
+  for ( size_t c = loader.GetCount( 8); c > 0; --c)
+    {
+    Variable v = loader.GetSomeVar();
+    _varUseCounts[v] = loader.GetIndex();
+    }
+  loader.GetVars( _unusedVarCandidates);
+
+  for ( size_t c = loader.GetCount( 9); c > 0; --c)
+    {
+    ConstraintGroup & group = _groups[loader.GetString()];
+    group._fActive = loader.GetFlag();
+    for ( size_t cCns = loader.GetCount( 4); cCns > 0; --cCns)
+      group._constraints.push_back( loader.GetSomeConstraint());
+    }
+  for ( size_t c = loader.GetCount( 29); c > 0; --c)
+    {
+    P_Constraint pcn = loader.GetSomeConstraint();
+    string group = loader.GetString();
+    LinearExpression expr;
+    loader.GetExpression( expr);
+    PreparedConstraint prep( group, expr);
+    prep._clvMarker = loader.GetVar();
+    prep._clvEminus = loader.GetVar();
+    prep._fRequired = loader.GetFlag();
+    _preparedConstraints.insert( PreparedConstraintMap::value_type( pcn, prep));
+    }
+
+  _slackCounter = loader.GetIndex();
+  _artificialCounter = loader.GetIndex();
+  _dummyCounter = loader.GetIndex();
+  _fAutosolve = loader.GetFlag();
+  _fResetStayConstantsAutomatically = loader.GetFlag();
+  _fRemoveUnusedVariablesAutomatically = loader.GetFlag();
+  _fNeedsSolving = loader.GetFlag();
+  _fExternalValuesInSync = loader.GetFlag();
+  _fExplainFailure = loader.GetFlag();
+  _fMinimalExplanations = loader.GetFlag();
+  _fWritesVariables = loader.GetFlag();
+  _fTableauBehind = loader.GetFlag();
+  loader.GetVars( _editedExternalRows);
+  _cRegionCacheLimit = loader.GetIndex();
+  _cBasisCacheLimit = loader.GetIndex();
+
+  while ( !_stkCedcns.empty())
+    _stkCedcns.pop();
+  for ( size_t c = loader.GetCount( 4); c > 0; --c)
+    _stkCedcns.push( loader.GetIndex());
+  if ( _stkCedcns.empty())
+    throw ExCLSolverFileError( "No edit count");
+}
+
+SimplexSolver::~SimplexSolver()
+{
+  ConstraintToVarMap::const_iterator it_cn = _markerVars.begin();
+  for ( ; it_cn != _markerVars.end(); ++it_cn)
+    {
+    (*it_cn).first->removedFrom(*this);
+    }
+#ifdef CL_SOLVER_STATS
+  cout << "_slackCounter == " << _slackCounter
+       << "\n_artificialCounter == " << _artificialCounter
+       << "\n_dummyCounter == " << _dummyCounter << endl;
+  cout << "stayMinusErrorVars " << _stayMinusErrorVars.size() << ", "
+       << "stayPlusErrorVars " << _stayPlusErrorVars.size() << ", "
+       << "errorVars " << _errorVars.size() << ", "
+       << "markerVars " << _markerVars.size() << endl;
+#endif
+  // Cannot print *this here, since local Variable-s may have been
+  // destructed already
+#ifdef CL_FIND_LEAK
+  cout << "die SimplexSolver== " << this << endl;
+#endif  
+}
+
+// Add the constraint cn to the tableau
+SimplexSolver & 
+SimplexSolver::AddConstraint( P_Constraint pcn)
+{
+#ifdef CL_TRACE
+  Tracer TRACER( __FUNCTION__);
+  cout << "(" << * pcn << ")" << endl;
+#endif
+  CheckAddable( pcn, true);
+  if (!FIsExplaining())
+    {
+    if ( AddConstraintInternal( pcn, NULL) != clsOk)
+      throw ExCLRequiredFailure();
+    return *this;
+    }
+  ConstraintSet explanation;
+  if ( AddConstraintInternal( pcn, &explanation) != clsOk)
+    {
+    ExCLRequiredFailureWithExplanation e;
+    ConstraintSet::const_iterator it = explanation.begin();
+    for ( ; it != explanation.end(); ++it)
+      e.AddConstraint(*it);
+    throw e;
+    }
+  return *this;
+}
+
+ClStatus
+SimplexSolver::TryAddConstraint( P_Constraint pcn, ConstraintSet * pexplanation)
+{
+#ifdef CL_TRACE
+  Tracer TRACER( __FUNCTION__);
+  cout << "(" << * pcn << ")" << endl;
+#endif
+  ClStatus status = CheckAddable( pcn, false);
+  if ( status != clsOk)
+    return status;
+  return AddConstraintInternal( pcn, pexplanation);
+}
+
+ClStatus
+SimplexSolver::CheckAddable( P_Constraint pcn, bool fThrow)
+{
+  if (!pcn->FIsOkayForSimplexSolver()) {
+    if ( fThrow)
+      throw ExCLTooDifficultSpecial("SimplexSolver cannot handle this constraint object");
+    return clsTooDifficult;
+  }
+
+  if ( pcn->IsStrictInequality()) {
+    // cannot handle strict inequalities
+    if ( fThrow)
+      throw ExCLStrictInequalityNotAllowed();
+    return clsTooDifficult;
+  }
+
+  if ( pcn->ReadOnlyVars().size() > 0) {
+    // cannot handle read-only vars
+    if ( fThrow)
+      throw ExCLReadOnlyNotAllowed();
+    return clsTooDifficult;
+  }
+
+  if ( pcn->IsEditConstraint())
+    {
+    if ( fThrow)
+      CheckNoTransaction("Adding an edit constraint");
+    else if ( FInTransaction())
+      return clsTransactionMisuse;
+    EditConstraint * pcnEdit = dynamic_cast<EditConstraint * >( pcn.ptr());
+    const Variable & v = pcnEdit->variable();
+    if (!v.IsExternal() ||
+        (!FIsBasicVar( v) && !ColumnsHasKey( v)))
+      {
+      // we could try to make this case work,
+      // but it'd be unnecessarily inefficient --
+      // and probably easier for the client application
+      // to deal with
+      if ( fThrow)
+        throw ExCLEditMisuse("( ExCLEditMisuse) Edit constraint on variable not in tableau.");
+      return clsEditMisuse;
+      }
+    }
+  return clsOk;
+}
+
+ClStatus
+SimplexSolver::AddConstraintInternal( P_Constraint pcn, 
+                                      ConstraintSet * pexplanation)
+{
+  if ( pcn->IsEditConstraint())
+    {
+    EditConstraint * pcnEdit = dynamic_cast<EditConstraint * >( pcn.ptr());
+    P_EditInfo pcei = PEditInfoFromv( pcnEdit->variable());
+    if ( pcei)
+      {
+      // we need to only add a partial _editInfoList entry for this
+      // edit constraint since the variable is already being edited.
+      // otherwise a more complete entry is added later in this function
+      P_EditInfo pceiPartial = new EditInfo( pcnEdit->variable(), NULL, 
+                                             clvNil, clvNil, 0);
+      pceiPartial->_itList = _editInfoList.insert( _editInfoList.end(), pceiPartial);
+      return clsOk;
+      }
+    }
+
+  Variable clvEplus, clvEminus;
+  Number prevEConstant;
+  // Log the changes made to add pcn, so that if it cannot be added
+  // they can just be undone, leaving the tableau as it was
+  size_t cEntries = BeginJournal();
+  ClStatus status = clsOk;
+  try 
+    {
+    P_LinearExpression expr = NewExpression( pcn, /* output to: */
+                                              clvEplus,clvEminus,
+                                              prevEConstant);
+    // If possible Add expr directly to the appropriate tableau by
+    // choosing a subject for expr ( a variable to become basic) from
+    // among the current variables in expr.  If this doesn't work use an
+    // artificial variable.  After adding expr re-Optimize.
+    if (!TryAddingDirectly( expr, status, pexplanation) && status == clsOk)
+      { // could not Add directly
+      if (!AddWithArtificialVariable( expr, pexplanation))
+        {
+#ifdef CL_DEBUG_FAILURES
+        cout << "Failed solve! Could not Add constraint.\n"
+             << *this << endl;
+#endif
+        status = clsRequiredFailure;
+        }
+      }
+    }
+  catch ( ... )
+    {
+    RollbackJournal( cEntries);
+    throw;
+    }
+  if ( status != clsOk)
+    {
+#ifdef CL_TRACE
+    cout << "could not Add -- rolling back" << endl;
+#endif
+    RollbackJournal( cEntries);
+    if ( pexplanation && _fMinimalExplanations)
+      MinimizeExplanation( pcn, *pexplanation);
+    return status;
+    }
+  CommitJournal();
+
+  _fNeedsSolving = true;
+
+  if ( pcn->IsEditConstraint())
+    {
+    EditConstraint * pcnEdit = dynamic_cast<EditConstraint * >( pcn.ptr());
+    const Variable & clv = pcnEdit->variable();
+    P_EditInfo pcei = new EditInfo( clv, pcnEdit, clvEplus, clvEminus,
+                                     prevEConstant);
+    NoteEditInUse( pcei);
+    }
+
+  if ( _fAutosolve)
+    {
+    Optimize( _objective);
+    SetExternalVariables();
+    }
+
+  NoteConstraintAdded( pcn);
+  return clsOk;
+}
+
+int
+SimplexSolver::AddConstraints( const vector<P_Constraint> & cns,
+                               vector<P_Constraint> * pFailed)
+{
+#ifdef CL_TRACE
+  Tracer TRACER( __FUNCTION__);
+#endif
+  vector<P_Constraint>::const_iterator it;
+  for ( it = cns.begin(); it != cns.end(); ++it)
+    {
+    const P_Constraint & pcn = *it;
+    if (!pcn->FIsOkayForSimplexSolver() || pcn->IsEditConstraint())
+      throw ExCLTooDifficultSpecial("SimplexSolver cannot add this constraint object in bulk");
+    if ( pcn->IsStrictInequality())
+      throw ExCLStrictInequalityNotAllowed();
+    if ( pcn->ReadOnlyVars().size() > 0)
+      throw ExCLReadOnlyNotAllowed();
+    }
+  if (!_fNeedsSolving)
+    RememberBasis();
+
+  int cAdded = 0;
+  // the first constraint that cannot be added directly, and all the
+  // ones after it, need phase 1.  Adding any of the later ones first
+  // could make a different required constraint the one that fails.
+  vector<P_Constraint> artificialCns;
+  for ( it = cns.begin(); it != cns.end(); ++it)
+    {
+    const P_Constraint & pcn = *it;
+    Variable clvEplus, clvEminus;
+    Number prevEConstant;
+    size_t cEntries = BeginJournal();
+    bool fAddedOkDirectly = false;
+    ClStatus status = clsOk;
+    try 
+      {
+      P_LinearExpression expr = NewExpression( pcn, clvEplus, clvEminus, prevEConstant);
+      fAddedOkDirectly = TryAddingDirectly( expr, status, NULL);
+      }
+    catch ( ... )
+      {
+      RollbackJournal( cEntries);
+      throw;
+      }
+    if ( status != clsOk)
+      {
+      RollbackJournal( cEntries);
+      if ( pFailed)
+        pFailed->push_back( pcn);
+      continue;
+      }
+    if (!fAddedOkDirectly)
+      {
+      // leave it and the rest out for now, to be dealt with below
+      RollbackJournal( cEntries);
+      artificialCns.assign( it, cns.end());
+      break;
+      }
+    CommitJournal();
+    NoteConstraintAdded( pcn);
+    ++cAdded;
+    }
+
+  if (!artificialCns.empty())
+    {
+    // phase 1: add av=expr for each of them, and minimize the sum of
+    // the artificial variables.  If that gets to 0, every one of them
+    // is 0 and can simply be taken out.  Log it all, so that otherwise
+    // it can be undone exactly.
+    size_t cEntries = BeginJournal();
+    bool fAllAdded = true;
+    try 
+      {
+      vector<Variable> artificialVars;
+      P_LinearExpression pazRow = new LinearExpression();
+      vector<P_Constraint>::const_iterator it_cn = artificialCns.begin();
+      for ( ; it_cn != artificialCns.end(); ++it_cn)
+        {
+        Variable clvEplus, clvEminus;
+        Number prevEConstant;
+        P_LinearExpression expr = NewExpression(*it_cn, clvEplus, clvEminus, prevEConstant);
+        P_AbstractVariable pav = new SlackVariable(++_artificialCounter, const_cast<char * >("a"));
+        pazRow->AddExpression(*expr);
+        addRow(*pav,expr);
+        artificialVars.push_back( pav);
+        }
+      P_AbstractVariable paz = new ObjectiveVariable("az");
+      addRow(*paz,pazRow);
+      Optimize(*paz);
+      fAllAdded = Approx( ConstRowExpression(*paz)->Constant(),0.0);
+      RemoveRow(*paz);
+      vector<Variable>::const_iterator it_av = artificialVars.begin();
+      for ( ; fAllAdded && it_av != artificialVars.end(); ++it_av)
+        {
+        fAllAdded = RemoveArtificialVariable(*it_av, false, NULL);
+        }
+      }
+    catch ( ... )
+      {
+      RollbackJournal( cEntries);
+      throw;
+      }
+
+    if ( fAllAdded)
+      {
+      CommitJournal();
+      vector<P_Constraint>::const_iterator it_cn = artificialCns.begin();
+      for ( ; it_cn != artificialCns.end(); ++it_cn)
+        {
+        NoteConstraintAdded(*it_cn);
+        ++cAdded;
+        }
+      }
+    else
+      {
+      // Some of them cannot be satisfied along with the rest.  Undo
+      // phase 1, and add them one at a time, as AddConstraint would,
+      // to leave out just the ones that fail.
+      RollbackJournal( cEntries);
+      bool fAutosolve = _fAutosolve;
+      _fAutosolve = false;
+      vector<P_Constraint>::const_iterator it_cn = artificialCns.begin();
+      try 
+        {
+        for ( ; it_cn != artificialCns.end(); ++it_cn)
+          {
+          if ( AddConstraintInternal(*it_cn, NULL) == clsOk)
+            ++cAdded;
+          else if ( pFailed)
+            pFailed->push_back(*it_cn);
+          }
+        }
+      catch ( ... )
+        {
+        _fAutosolve = fAutosolve;
+        throw;
+        }
+      _fAutosolve = fAutosolve;
+      }
+    }
+
+  _fNeedsSolving = true;
+  if ( _fAutosolve)
+    {
+    OptimizeFromBasisCache();
+    SetExternalVariables();
+    }
+  return cAdded;
+}
+
+// Add weak stays to the x and y parts of each point. These have
+// increasing weights so that the solver will try to satisfy the x
+// and y stays on the same point, rather than the x stay on one and
+// the y stay on another.
+SimplexSolver & 
+SimplexSolver::AddPointStays( const vector<const Point * > & listOfPoints,
+                               const Strength & strength)
+{
+#ifdef CL_TRACE
+  Tracer TRACER( __FUNCTION__);
+#endif
+
+  vector<const Point * >::const_iterator it = listOfPoints.begin();
+  double weight = 1.0;
+  static const double multiplier = 2.0;
+  for ( ; it != listOfPoints.end(); ++it )
+    {
+    AddPointStay((*it)->X(),(*it)->Y(),strength,weight);
+    weight *= multiplier;
+    }
+  return *this;
+}
+
+SimplexSolver & 
+SimplexSolver::AddPointStay( const Point & clp, const Strength & strength, double weight)
+{ 
+  AddPointStay( clp.X(),clp.Y(),strength,weight);
+  return *this;
+}
+
+
+SimplexSolver & 
+SimplexSolver::RemoveEditVarsTo( int n)
+{
+  queue<Variable> qclv;
+  VarSet sclvStillEditing; // Set of edit variables that we need to * not* remove
+#ifdef DEBUG_NESTED_EDITS
+  cout << __FUNCTION__ << " " << n << endl;
+#endif
+  int i = 0;
+  for ( EditInfoList::const_iterator it = _editInfoList.begin();
+        ( it != _editInfoList.end() && _editInfoList.size() != (unsigned)n);
+        ++it, ++i ) 
+    {
+    P_EditInfo pcei = (*it);
+    assert( pcei);
+#ifdef DEBUG_NESTED_EDITS
+    cout << __FUNCTION__ << "Checking " << pcei->_clv
+         << ", index = " << i << endl;
+#endif
+    if ( i >= n 
+         && pcei->_pconstraint)      //FIX: svd - complementary of 
+                    //::AddConstraint() - adding a partial _editInfoList 
+                    //_editInfoList.push_back( new EditInfo( v, NULL, clvNil, clvNil, 0));
+      qclv.push( pcei->_clv);
+    else
+      sclvStillEditing.insert( pcei->_clv);
+    }
+  while (!qclv.empty()) 
+    {
+    Variable clv = qclv.front();
+    // only remove the variable if it's not in the set of variable
+    // from a previous nested outer edit
+    // e.g., if I do:
+    // Edit x,y
+    // Edit w,h,x,y
+    // EndEdit
+    // The end edit needs to only get rid of the edits on w,h
+    // not the ones on x,y
+    if ( sclvStillEditing.find( clv) == sclvStillEditing.end())
+      {
+#ifdef DEBUG_NESTED_EDITS
+      cout << __FUNCTION__ << ": Removing " << clv << endl;
+#endif
+      RemoveEditVar( clv);
+      }
+#ifdef DEBUG_NESTED_EDITS
+    else
+      {
+      cout << __FUNCTION__ << ": Not removing " << clv << endl;
+      }
+#endif
+    qclv.pop();
+    }
+  while ( _editInfoList.size() > (unsigned)n) {
+    _editInfoList.pop_back();
+  }
+  
+  return *this;
+}
+
+
+/* A predicate used for remove_if */
+class VarInVarSet : public unary_function<Variable,bool> {
+public:
+  VarInVarSet( const VarSet & clvset) : 
+      _set( clvset),
+      _setEnd( const_cast<VarSet &>(clvset).end() ) 
+    { }
+
+  bool operator ()( const Variable & clv) const {
+    return ( _set.find( clv) != _setEnd);
+  }
+  
+private:
+  const VarSet & _set;
+  const VarSet::iterator _setEnd;
+};
+
+void
+SimplexSolver::RemoveStayErrorVars( const VarSet & eVars)
+{
+  if ( _psweptStayErrorVars)
+    {
+    _psweptStayErrorVars->insert( eVars.begin(), eVars.end());
+    return;
+    }
+  if ( _pjournal)
+    {
+    _pjournal->SaveValue( _stayPlusErrorVars);
+    _pjournal->SaveValue( _stayMinusErrorVars);
+    }
+  _stayPlusErrorVars
+    .erase( remove_if( _stayPlusErrorVars.begin(),_stayPlusErrorVars.end(),
+                       VarInVarSet( eVars)),
+            _stayPlusErrorVars.end());
+  _stayMinusErrorVars
+    .erase( remove_if( _stayMinusErrorVars.begin(),_stayMinusErrorVars.end(),
+                       VarInVarSet( eVars)),
+            _stayMinusErrorVars.end());
+}
+
+
+
+// Remove the constraint cn from the tableau
+// Also remove any error variable associated with cn
+SimplexSolver & 
+SimplexSolver::RemoveConstraintInternal( P_Constraint pcn)
+{
+#ifdef CL_TRACE
+  Tracer TRACER( __FUNCTION__);
+  cout << "(" << * pcn << ")" << endl;
+#endif
+
+  // We are about to remove a constraint.  There may be some stay
+  // constraints that were unsatisfied previously -- if we just
+  // removed the constraint these could come into play.  Instead,
+  // Reset all of the stays so that things should stay where they are
+  // at the moment.
+  _fNeedsSolving = true;
+
+  ResetStayConstants();
+
+  RemoveConstraintRows( pcn);
+
+  if ( _fAutosolve)
+    {
+    Optimize( _objective);
+    SetExternalVariables();
+    }
+
+  return *this;
+}
+
+// Make marker basic, pivoting on the row that keeps the other rows
+// feasible, and drop its row
+void
+SimplexSolver::RemoveMarkerRow( const Variable & marker)
+{
+#ifdef CL_TRACE
+  cout << "Looking to remove var " << marker << endl;
+#endif
+  if (!FIsBasicVar( marker))
+    { // not in the basis, so need to do some work
+    // first choose which variable to move out of the basis
+    // only consider restricted basic variables
+    const VarSet & col = ConstColumn( marker);
+    VarSet::const_iterator it_col = col.begin();
+#ifdef CL_TRACE
+    cout << "Must Pivot -- columns are " << col << endl;
+#endif
+
+    Variable exitVar = clvNil;
+    bool fExitVarSet = false;
+    double minRatio = 0.0;
+    for ( ; it_col != col.end(); ++it_col) 
+      {
+      const Variable & v = *it_col;
+      if ( v.IsRestricted() )
+        {
+        P_LinearExpression pexpr = RowExpression( v);
+        assert( pexpr != NULL );
+        Number coeff = pexpr->CoefficientFor( marker);
+#ifdef CL_TRACE
+        cout << "Marker " << marker << "'s coefficient in " << * pexpr << " is "
+             << coeff << endl;
+#endif
+        // only consider negative coefficients
+        if ( coeff < 0.0) 
+          {
+          Number r = - pexpr->Constant() / coeff;
+          if (!fExitVarSet || r < minRatio)
+            {
+            minRatio = r;
+            exitVar = v;
+            fExitVarSet = true;
+            }
+          }
+        }
+      }
+    // if we didn't set exitvar above, then either the marker
+    // variable has a positive coefficient in all equations, or it
+    // only occurs in equations for unrestricted variables.  If it
+    // does occur in an equation for a restricted variable, pick the
+    // equation that gives the smallest ratio.  ( The row with the
+    // marker variable will become infeasible, but all the other rows
+    // will still be feasible; and we will be dropping the row with
+    // the marker variable.  In effect we are removing the
+    // non-negativity restriction on the marker variable.)
+    if (!fExitVarSet)
+      {
+#ifdef CL_TRACE
+      cout << "exitVar did not get set" << endl;
+#endif
+      it_col = col.begin();
+      for ( ; it_col != col.end(); ++it_col) 
+        {
+        Variable v = * it_col;
+        if ( v.IsRestricted() )
+          {
+          P_LinearExpression pexpr = RowExpression( v);
+          assert( pexpr != NULL);
+          Number coeff = pexpr->CoefficientFor( marker);
+          Number r = pexpr->Constant() / coeff;
+          if (!fExitVarSet || r < minRatio)
+            {
+            minRatio = r;
+            exitVar = v;
+            fExitVarSet = true;
+            }
+          }
+        }
+      }
+
+    if (!fExitVarSet)
+      { // exitVar is still nil
+      // If col is empty, then exitVar doesn't occur in any equations,
+      // so just remove it.  Otherwise pick an exit var from among the
+      // unrestricted variables whose equation involves the marker var
+      if ( col.size() == 0)
+        {
+        RemoveColumn( marker);
+        }
+      else
+        {
+          // A. Beurive' Tue Sep 14 18:26:05 CEST 1999
+          // Don't pick the objective, or it will be removed!
+          it_col = col.begin();
+          for ( ; it_col != col.end(); ++it_col)
+            {
+              Variable v = * it_col;
+              if ( v != _objective)
+                {
+                  exitVar = v;
+                  fExitVarSet = true;
+                  break;
+                }
+            }
+          assert( fExitVarSet == true);
+        }
+      }
+    
+    if ( fExitVarSet)
+      {
+      Pivot( marker,exitVar);
+      }
+    }
+  
+  if ( FIsBasicVar( marker))
+    {
+    P_LinearExpression pexpr = RemoveRow( marker);
+#ifdef CL_TRACE
+    cout << "delete@ " << pexpr.ptr() << endl;
+#endif
+    }
+}
+
+// Take pcn's marker and error variables out of the tableau and the
+// objective, leaving the stay constants and optimizing to the caller
+void
+SimplexSolver::RemoveConstraintRows( P_Constraint pcn)
+{
+#ifdef CL_TRACE
+  Tracer TRACER( __FUNCTION__);
+  cout << "(" << * pcn << ")" << endl;
+#endif
+  if ( pcn->IsEditConstraint())
+    CheckNoTransaction("Removing an edit constraint");
+  CatchUpTableau();
+  ClearRegionCache();
+
+  // remove any error variables from the objective function
   P_LinearExpression pzRow = RowExpression( _objective);
 
 #ifdef CL_TRACE
@@ -431,6 +2317,7 @@ SimplexSolver::RemoveConstraintInternal( P_Constraint pcn)
   ConstraintToVarSetMap::iterator 
     it_eVars = _errorVars.find( pcn);
   bool fFoundErrorVar = ( it_eVars != _errorVars.end());
+  Number coeff = ErrorWeight( pcn);
 
   if ( fFoundErrorVar)
     {
@@ -438,16 +2325,16 @@ SimplexSolver::RemoveConstraintInternal( P_Constraint pcn)
     VarSet::iterator it = eVars.begin();
     for ( ; it != eVars.end(); ++it )
       {
-      P_LinearExpression pexpr = RowExpression(*it);
+      P_LinearExpression pexpr = ConstRowExpression(*it);
       if ( pexpr == NULL )
         {
-        pzRow->AddVariable(*it,-pcn->weight() * pcn->strength().symbolicWeight().AsDouble(),
-                           _objective,*this);
+        JournalTerms( pzRow,*it);
+        pzRow->AddVariable(*it,-coeff,_objective,*this);
         }
       else
         { // the error variable was in the basis
-        pzRow->AddExpression(*pexpr,-pcn->weight() * pcn->strength().symbolicWeight().AsDouble(),
-                             _objective,*this);
+        JournalTerms( pzRow,*pexpr,clvNil);
+        pzRow->AddExpression(*pexpr,-coeff,_objective,*this);
         }
       }
     }
@@ -460,194 +2347,763 @@ SimplexSolver::RemoveConstraintInternal( P_Constraint pcn)
     }
   // try to make the marker variable basic if it isn't already
   const Variable marker = (*it_marker).second;
+  _activeFingerprint -= FingerprintTerm( marker, coeff);
+  JournalEntry( _markerVars, pcn);
   _markerVars.erase( it_marker);
+  JournalEntry( _constraintsMarked, marker);
   _constraintsMarked.erase( marker);
+
+  // undo the variable bookkeeping done in NewExpression
+  if ( pcn->isStayConstraint())
+    {
+    StayConstraint * pcnStay = dynamic_cast<StayConstraint * >( pcn.ptr());
+    VarToConstraintSetMap::iterator 
+      it_stays = _stayConstraints.find( pcnStay->variable());
+    if ( it_stays != _stayConstraints.end())
+      {
+      JournalEntry( _stayConstraints, pcnStay->variable());
+      (*it_stays).second.erase( pcn);
+      if ( (*it_stays).second.empty())
+        _stayConstraints.erase( it_stays);
+      }
+    }
+  else if (!pcn->IsEditConstraint())
+    {
+    PreparedConstraintMap::const_iterator it_prep = _preparedConstraints.find( pcn);
+    LinearExpression cnExprCopy;
+    if ( it_prep == _preparedConstraints.end())
+      cnExprCopy = pcn->Expression();
+    const LinearExpression & cnExpr = ( it_prep != _preparedConstraints.end())? 
+      (*it_prep).second._expression : cnExprCopy;
+    const VarToNumberMap & cnTerms = cnExpr.Terms();
+    VarToNumberMap::const_iterator it_term = cnTerms.begin();
+    for ( ; it_term != cnTerms.end(); ++it_term)
+      {
+      const Variable & v = (*it_term).first;
+      VarToIntMap::iterator it_count = _varUseCounts.find( v);
+      if ( it_count == _varUseCounts.end())
+        continue;
+      JournalEntry( _varUseCounts, v);
+      if ( --(*it_count).second <= 0)
+        {
+        _varUseCounts.erase( it_count);
+        if ( _fRemoveUnusedVariablesAutomatically &&
+             _stayConstraints.find( v) != _stayConstraints.end())
+          _unusedVarCandidates.insert( v);
+        }
+      }
+    }
+  RemoveMarkerRow( marker);
+
+  // Delete any error variables.  If cn is an inequality, it also
+  // contains a slack variable; but we use that as the marker variable
+  // and so it has been deleted when we removed its row.
+  if ( fFoundErrorVar)
+    {
+    VarSet & eVars = (*it_eVars).second;
+    VarSet::iterator it = eVars.begin();
+    for ( ; it != eVars.end(); ++it )
+      {
+      Variable v = (*it);
+      if ( v != marker)
+        {
+        RemoveColumn( v);
+        }
+      }
+    }
+
+  if ( pcn->isStayConstraint())
+    {
+    // remove the variables in the stay{Plus,Minus}ErrorVars that are
+    // also in set eVars
+    if ( fFoundErrorVar)
+      RemoveStayErrorVars( (*it_eVars).second);
+    }
+  else if ( pcn->IsEditConstraint())
+    {
+    EditConstraint * pcnEdit = dynamic_cast<EditConstraint * >( pcn.ptr());
+    const Variable & clv = pcnEdit->variable();
+    P_EditInfo pcei = PEditInfoFromv( clv);
+    assert( pcei);
+    Variable clvEditMinus = pcei->_clvEditMinus;
+    RemoveColumn( clvEditMinus);  // clvEditPlus is a marker var and gets removed later
+    NoteEditDone( pcei);
+    }
+
+  if ( fFoundErrorVar)
+    {
+    // This code is not needed since the variables are deleted
+    // when they are removed from the row --
+    // leaving it in results in double deletions
+    // delete the constraint's error variables
+    //    VarSet & evars_set = (*it_eVars).second;
+    //    VarSet::const_iterator it_set = evars_set.begin();
+    //    for ( ; it_set != evars_set.end(); ++it_set)
+    //      {
+    //      delete * it_set;
+    //      }
+    NoteErrorVarsRemoved( pcn);
+    JournalEntry( _errorVars, pcn);
+    _errorVars.erase( it_eVars);
+    JournalEntry( _errorWeights, pcn);
+    _errorWeights.erase( pcn);
+    }
+}
+
+ClStatus
+SimplexSolver::TryRemoveConstraint( P_Constraint pcn)
+{
+  if ( _markerVars.find( pcn) == _markerVars.end())
+    return clsConstraintNotFound;
+  if ( pcn->IsEditConstraint() && FInTransaction())
+    return clsTransactionMisuse;
+  RemoveConstraint( pcn);
+  return clsOk;
+}
+
+SimplexSolver &
+SimplexSolver::RemoveConstraints( const vector<P_Constraint> & cns)
+{
 #ifdef CL_TRACE
-  cout << "Looking to remove var " << marker << endl;
+  Tracer TRACER( __FUNCTION__);
 #endif
-  if (!FIsBasicVar( marker))
-    { // not in the basis, so need to do some work
-    // first choose which variable to move out of the basis
-    // only consider restricted basic variables
-    VarSet & col = _columns[marker];
-    VarSet::iterator it_col = col.begin();
+  if (!_fNeedsSolving)
+    RememberBasis();
+  RemoveConstraintsInternal( cns);
+  if ( _fAutosolve)
+    {
+    OptimizeFromBasisCache();
+    SetExternalVariables();
+    }
+  if ( _fRemoveUnusedVariablesAutomatically) 
+    RemoveUnusedVariableCandidates();
+  return *this;
+}
+
+void
+SimplexSolver::RemoveConstraintsInternal( const vector<P_Constraint> & cns)
+{
+  CatchUpTableau();
+  // Check them all before touching anything.  Constraints whose
+  // markers are basic just lose their rows, so take those out first;
+  // the others need a pivot each.
+  ConstraintSet seen;
+  vector<P_Constraint> ordered;
+  vector<P_Constraint> needPivot;
+  vector<P_Constraint>::const_iterator it = cns.begin();
+  for ( ; it != cns.end(); ++it)
+    {
+    ConstraintToVarMap::const_iterator it_marker = _markerVars.find(*it);
+    if ( it_marker == _markerVars.end())
+      throw ExCLConstraintNotFound(*it);
+    if (!seen.insert(*it).second)
+      continue;
+    if ( FIsBasicVar( (*it_marker).second))
+      ordered.push_back(*it);
+    else
+      needPivot.push_back(*it);
+    }
+  ordered.insert( ordered.end(), needPivot.begin(), needPivot.end());
+  if ( ordered.empty())
+    return;
+
+  // as in RemoveConstraintInternal, but once for the whole lot
+  _fNeedsSolving = true;
+  ResetStayConstants();
+
+  for ( it = ordered.begin(); it != ordered.end(); ++it)
+    {
+    RemoveConstraintRows(*it);
+    NoteConstraintRemoved(*it);
+    }
+}
+
+
+// Remove all the stays on each of vars, and with them their columns.
+// Callers make sure no other constraint uses them, so they should then
+// be gone from the tableau entirely.  The stays all go through one
+// RemoveConstraintsInternal(), and their error variables leave the
+// stay arrays in one pass at the end.
+void
+SimplexSolver::RemoveStays( const VarVector & vars)
+{
 #ifdef CL_TRACE
-    cout << "Must Pivot -- columns are " << col << endl;
+  Tracer TRACER( __FUNCTION__);
 #endif
+  if ( vars.empty())
+    return;
+  vector<P_Constraint> stays;
+  VarVector::const_iterator it_var = vars.begin();
+  for ( ; it_var != vars.end(); ++it_var)
+    {
+    VarToConstraintSetMap::const_iterator it_stays = _stayConstraints.find(*it_var);
+    if ( it_stays != _stayConstraints.end())
+      stays.insert( stays.end(), (*it_stays).second.begin(), (*it_stays).second.end());
+    }
 
-    Variable exitVar = clvNil;
-    bool fExitVarSet = false;
-    double minRatio = 0.0;
-    for ( ; it_col != col.end(); ++it_col) 
+  VarSet sweptStayErrorVars;
+  _psweptStayErrorVars = &sweptStayErrorVars;
+  try
+    {
+    RemoveConstraintsInternal( stays);
+    for ( it_var = vars.begin(); it_var != vars.end(); ++it_var)
       {
-      const Variable & v = *it_col;
-      if ( v.IsRestricted() )
-        {
-        P_LinearExpression pexpr = RowExpression( v);
-        assert( pexpr != NULL );
-        Number coeff = pexpr->CoefficientFor( marker);
+      RemoveColumn(*it_var);
+      _reportedValues.erase(*it_var);
+      }
+    }
+  catch ( ... )
+    {
+    _psweptStayErrorVars = NULL;
+    RemoveStayErrorVars( sweptStayErrorVars);
+    throw;
+    }
+  _psweptStayErrorVars = NULL;
+  RemoveStayErrorVars( sweptStayErrorVars);
+
+  _fNeedsSolving = true;
+  if ( _fAutosolve)
+    {
+    Optimize( _objective);
+    SetExternalVariables();
+    }
+}
+
+SimplexSolver & 
+SimplexSolver::RemoveVariable( const Variable & v)
+{
+  CheckNoTransaction("RemoveVariable");
+  if ( NumConstraintsUsing( v) > 0 || PEditInfoFromv( v))
+    {
+#ifndef CL_NO_IO
+    ostringstream ss;
+    ss << "RemoveVariable for variable " << v << ", but var is still in use";
+    throw ExCLVariableInUse( ss.str() );
+#else
+    throw ExCLVariableInUse( v.Name() );
+#endif
+    }
+  if ( FHasEditSlot( v))
+    RemoveEditSlot( v);
+  RemoveStays( VarVector( 1, v));
+  _unusedVarCandidates.erase( v);
+  return *this;
+}
+
+SimplexSolver & 
+SimplexSolver::RemoveUnusedVariables()
+{
+  CheckNoTransaction("RemoveUnusedVariables");
+  VarVector unused;
+  VarToConstraintSetMap::const_iterator it = _stayConstraints.begin();
+  for ( ; it != _stayConstraints.end(); ++it)
+    {
+    const Variable & v = (*it).first;
+    if ( NumConstraintsUsing( v) == 0 && !PEditInfoFromv( v) && !FHasEditSlot( v))
+      unused.push_back( v);
+    }
+  RemoveStays( unused);
+  _unusedVarCandidates.clear();
+  return *this;
+}
+
+// Only look at the variables that lost their last user constraint
+// since the previous sweep, so the automatic sweep costs nothing
+// when no variable became unused
+void
+SimplexSolver::RemoveUnusedVariableCandidates()
+{
+  if ( _unusedVarCandidates.empty())
+    return;
+  VarSet candidates;
+  candidates.swap( _unusedVarCandidates);
+  VarVector unused;
+  VarSet::const_iterator it = candidates.begin();
+  for ( ; it != candidates.end(); ++it)
+    {
+    const Variable & v = (*it);
+    // a later constraint may have started using v again
+    if ( NumConstraintsUsing( v) == 0 && !PEditInfoFromv( v) && !FHasEditSlot( v))
+      unused.push_back( v);
+    }
+  RemoveStays( unused);
+}
+
+SimplexSolver & 
+SimplexSolver::AddToGroup( const string & name, P_Constraint pcn)
+{
+  CheckNoTransaction("AddToGroup");
+  if ( pcn->IsEditConstraint() || pcn->isStayConstraint())
+    throw ExCLTooDifficultSpecial("Edit and stay constraints cannot be grouped");
+  // ( pcn may be in other solvers, clones included)
+  if ( _markerVars.find( pcn) != _markerVars.end() || 
+       _preparedConstraints.find( pcn) != _preparedConstraints.end())
+    throw ExCLTooDifficultSpecial("Constraint is already in the solver or in a group");
+
+  ConstraintGroup & group = _groups[name];
+  _preparedConstraints.insert( PreparedConstraintMap::value_type( 
+      pcn, PreparedConstraint( name, pcn->Expression())));
+  group._constraints.push_back( pcn);
+  if ( group._fActive)
+    {
+    try 
+      {
+      AddConstraint( pcn);
+      }
+    catch ( ExCLError & )
+      {
+      group._constraints.pop_back();
+      _preparedConstraints.erase( pcn);
+      throw;
+      }
+    }
+  return *this;
+}
+
+SimplexSolver & 
+SimplexSolver::RemoveFromGroup( P_Constraint pcn)
+{
+  CheckNoTransaction("RemoveFromGroup");
+  PreparedConstraintMap::iterator it_prep = _preparedConstraints.find( pcn);
+  if ( it_prep == _preparedConstraints.end())
+    throw ExCLConstraintNotFound( pcn);
+  ConstraintGroup & group = _groups[(*it_prep).second._group];
+  if ( group._fActive)
+    RemoveConstraint( pcn);
+  group._constraints.erase( find( group._constraints.begin(),
+                                  group._constraints.end(), pcn));
+  _preparedConstraints.erase( it_prep);
+  return *this;
+}
+
+SimplexSolver & 
+SimplexSolver::RemoveGroup( const string & name)
+{
+  CheckNoTransaction("RemoveGroup");
+  ConstraintGroupMap::iterator it_group = _groups.find( name);
+  if ( it_group == _groups.end())
+    return *this;
+  if ( (*it_group).second._fActive)
+    DeactivateGroup( name);
+  vector<P_Constraint> & cns = (*it_group).second._constraints;
+  vector<P_Constraint>::const_iterator it = cns.begin();
+  for ( ; it != cns.end(); ++it)
+    {
+    _preparedConstraints.erase(*it);
+    }
+  _groups.erase( it_group);
+  return *this;
+}
+
+// The group called name; throws if there is none, so that a misspelt
+// name does not quietly switch an empty group
+SimplexSolver::ConstraintGroup &
+SimplexSolver::FindGroup( const string & name)
+{
+  ConstraintGroupMap::iterator it_group = _groups.find( name);
+  if ( it_group == _groups.end())
+    throw ExCLTooDifficultSpecial("No constraint group named " + name);
+  return (*it_group).second;
+}
+
+// Add all the constraints of group to the tableau.  If one of them
+// fails, the exception goes through, and the caller's transaction
+// takes back the ones added so far.
+void
+SimplexSolver::AddGroupConstraints( ConstraintGroup & group)
+{
+  vector<P_Constraint>::iterator it = group._constraints.begin();
+  for ( ; it != group._constraints.end(); ++it)
+    {
+    AddConstraint(*it);
+    }
+  group._fActive = true;
+}
+
+// Take the constraints of all of groups out together, so that the
+// stays are reset only once, while the tableau is still optimal
+void
+SimplexSolver::RemoveGroupConstraints( const vector<ConstraintGroup * > & groups)
+{
+  vector<P_Constraint> cns;
+  vector<ConstraintGroup * >::const_iterator it = groups.begin();
+  for ( ; it != groups.end(); ++it)
+    {
+    cns.insert( cns.end(), (*it)->_constraints.begin(), (*it)->_constraints.end());
+    }
+  RemoveConstraintsInternal( cns);
+  for ( it = groups.begin(); it != groups.end(); ++it)
+    {
+    (*it)->_fActive = false;
+    }
+}
+
+SimplexSolver & 
+SimplexSolver::SwitchGroups( const vector<string> & namesOff,
+                             const vector<string> & namesOn)
+{
+  CheckNoTransaction("SwitchGroups");
 #ifdef CL_TRACE
-        cout << "Marker " << marker << "'s coefficient in " << * pexpr << " is "
-             << coeff << endl;
+  Tracer TRACER( __FUNCTION__);
 #endif
-        // only consider negative coefficients
-        if ( coeff < 0.0) 
-          {
-          Number r = - pexpr->Constant() / coeff;
-          if (!fExitVarSet || r < minRatio)
-            {
-            minRatio = r;
-            exitVar = v;
-            fExitVarSet = true;
-            }
-          }
-        }
+  vector<ConstraintGroup * > groupsOff;
+  vector<ConstraintGroup * > groupsOn;
+  vector<string>::const_iterator it_name = namesOff.begin();
+  for ( ; it_name != namesOff.end(); ++it_name)
+    {
+    groupsOff.push_back(&FindGroup( *it_name));
+    }
+  for ( it_name = namesOn.begin(); it_name != namesOn.end(); ++it_name)
+    {
+    groupsOn.push_back(&FindGroup( *it_name));
+    }
+
+  if (!_fNeedsSolving)
+    RememberBasis();
+
+  // Hold off optimizing until every group has been switched, and log
+  // the switch, so that if a group cannot be switched on it can be
+  // undone exactly ( taking the constraints back out would reset the
+  // stays on the unoptimized tableau)
+  bool fAutosolve = _fAutosolve;
+  _fAutosolve = false;
+  vector<ConstraintGroup * > switchedOff;
+  vector<ConstraintGroup * > switchedOn;
+  vector<ConstraintGroup * >::iterator it;
+  BeginTransaction();
+  try
+    {
+    for ( it = groupsOff.begin(); it != groupsOff.end(); ++it)
+      {
+      if ( (*it)->_fActive && 
+           find( switchedOff.begin(), switchedOff.end(), *it) == switchedOff.end())
+        switchedOff.push_back(*it);
       }
-    // if we didn't set exitvar above, then either the marker
-    // variable has a positive coefficient in all equations, or it
-    // only occurs in equations for unrestricted variables.  If it
-    // does occur in an equation for a restricted variable, pick the
-    // equation that gives the smallest ratio.  ( The row with the
-    // marker variable will become infeasible, but all the other rows
-    // will still be feasible; and we will be dropping the row with
-    // the marker variable.  In effect we are removing the
-    // non-negativity restriction on the marker variable.)
-    if (!fExitVarSet)
+    RemoveGroupConstraints( switchedOff);
+    for ( it = groupsOn.begin(); it != groupsOn.end(); ++it)
       {
-#ifdef CL_TRACE
-      cout << "exitVar did not get set" << endl;
-#endif
-      it_col = col.begin();
-      for ( ; it_col != col.end(); ++it_col) 
+      if (!(*it)->_fActive)
         {
-        Variable v = * it_col;
-        if ( v.IsRestricted() )
-          {
-          P_LinearExpression pexpr = RowExpression( v);
-          assert( pexpr != NULL);
-          Number coeff = pexpr->CoefficientFor( marker);
-          Number r = pexpr->Constant() / coeff;
-          if (!fExitVarSet || r < minRatio)
-            {
-            minRatio = r;
-            exitVar = v;
-            fExitVarSet = true;
-            }
-          }
+        AddGroupConstraints(**it);
+        switchedOn.push_back(*it);
         }
       }
-
-    if (!fExitVarSet)
-      { // exitVar is still nil
-      // If col is empty, then exitVar doesn't occur in any equations,
-      // so just remove it.  Otherwise pick an exit var from among the
-      // unrestricted variables whose equation involves the marker var
-      if ( col.size() == 0)
-        {
-        RemoveColumn( marker);
-        }
-      else
-        {
-          // A. Beurive' Tue Sep 14 18:26:05 CEST 1999
-          // Don't pick the objective, or it will be removed!
-          it_col = col.begin();
-          for ( ; it_col != col.end(); ++it_col)
-            {
-              Variable v = * it_col;
-              if ( v != _objective)
-                {
-                  exitVar = v;
-                  fExitVarSet = true;
-                  break;
-                }
-            }
-          assert( fExitVarSet == true);
-        }
+    }
+  catch ( ... )
+    {
+    // put the groups back the way they were
+    RollbackTransaction();
+    for ( it = switchedOff.begin(); it != switchedOff.end(); ++it)
+      {
+      (*it)->_fActive = true;
       }
-    
-    if ( fExitVarSet)
+    for ( it = switchedOn.begin(); it != switchedOn.end(); ++it)
       {
-      Pivot( marker,exitVar);
+      (*it)->_fActive = false;
       }
+    _fAutosolve = fAutosolve;
+    throw;
     }
-  
-  if ( FIsBasicVar( marker))
+  CommitTransaction();
+
+  _fAutosolve = fAutosolve;
+  if ( _fAutosolve)
     {
-    P_LinearExpression pexpr = RemoveRow( marker);
-#ifdef CL_TRACE
-    cout << "delete@ " << pexpr.ptr() << endl;
-#endif
+    OptimizeFromBasisCache();
+    SetExternalVariables();
     }
+  return *this;
+}
 
-  // Delete any error variables.  If cn is an inequality, it also
-  // contains a slack variable; but we use that as the marker variable
-  // and so it has been deleted when we removed its row.
-  if ( fFoundErrorVar)
+void
+SimplexSolver::ReplaceConstraint( P_Constraint pcnOld, P_Constraint pcnNew)
+{
+  ConstraintToVarMap::iterator it_marker = _markerVars.find( pcnOld);
+  if ( it_marker == _markerVars.end())
+    throw ExCLConstraintNotFound( pcnOld);
+  const Variable marker = (*it_marker).second;
+  JournalEntry( _markerVars, pcnOld);
+  JournalEntry( _markerVars, pcnNew);
+  JournalEntry( _constraintsMarked, marker);
+  _markerVars.erase( it_marker);
+  _markerVars[pcnNew] = marker;
+  _constraintsMarked[marker] = pcnNew;
+
+  ConstraintToVarSetMap::iterator it_eVars = _errorVars.find( pcnOld);
+  if ( it_eVars != _errorVars.end())
     {
-    VarSet & eVars = (*it_eVars).second;
-    VarSet::iterator it = eVars.begin();
-    for ( ; it != eVars.end(); ++it )
+    VarSet eVars = (*it_eVars).second;
+    bool fUnsatisfied = ( _unsatisfiedCns.find( pcnOld) != _unsatisfiedCns.end());
+    NoteErrorVarsRemoved( pcnOld);
+    JournalEntry( _errorVars, pcnOld);
+    JournalEntry( _errorVars, pcnNew);
+    _errorVars.erase( pcnOld);
+    _errorVars[pcnNew] = eVars;
+    NoteErrorVarsAdded( pcnNew);
+    if ( !pcnOld->IsEditConstraint())
       {
-      Variable v = (*it);
-      if ( v != marker)
-        {
-        RemoveColumn( v);
-        }
+      // the objective still has pcnOld's weight
+      Number weight = ErrorWeight( pcnOld);
+      JournalEntry( _errorWeights, pcnOld);
+      JournalEntry( _errorWeights, pcnNew);
+      _errorWeights.erase( pcnOld);
+      _errorWeights[pcnNew] = weight;
+      }
+    if ( fUnsatisfied)
+      {
+      if ( _pjournal)
+        _pjournal->SaveMember( _unsatisfiedCns, pcnNew);
+      _unsatisfiedCns.insert( pcnNew);
       }
     }
+  NoteConstraintRemoved( pcnOld);
+  NoteConstraintAdded( pcnNew);
+}
 
-  if ( pcn->isStayConstraint())
+SimplexSolver & 
+SimplexSolver::Reconcile( const vector<P_Constraint> & desired)
+{
+  CheckNoTransaction("Reconcile");
+#ifdef CL_TRACE
+  Tracer TRACER( __FUNCTION__);
+#endif
+  typedef multimap<size_t, P_Constraint> HashToConstraintMap;
+  if (!_fNeedsSolving)
+    RememberBasis();
+
+  // Desired constraints that are in the tableau already stay; the
+  // others are added unless they can be matched up below
+  ConstraintSet kept;
+  ConstraintSet pendingSet;
+  vector<P_Constraint> pending;
+  vector<P_Constraint>::const_iterator it_desired = desired.begin();
+  for ( ; it_desired != desired.end(); ++it_desired)
     {
-    // iterate over the stay{Plus,Minus}ErrorVars and remove those
-    // variables v in those vectors that are also in set eVars
-    if ( fFoundErrorVar)
+    const P_Constraint & pcn = *it_desired;
+    if ( pcn->IsEditConstraint() || pcn->isStayConstraint() ||
+         _preparedConstraints.find( pcn) != _preparedConstraints.end())
+      throw ExCLTooDifficultSpecial("Reconcile cannot take edit, stay or grouped constraints");
+    if ( _markerVars.find( pcn) != _markerVars.end())
+      kept.insert( pcn);
+    else if ( pendingSet.insert( pcn).second)
+      pending.push_back( pcn);
+    }
+
+  HashToConstraintMap unmatched;
+  ConstraintToVarMap::const_iterator it_marker = _markerVars.begin();
+  for ( ; it_marker != _markerVars.end(); ++it_marker)
+    {
+    const P_Constraint & pcn = (*it_marker).first;
+    if ( pcn->IsEditConstraint() || pcn->isStayConstraint() ||
+         kept.find( pcn) != kept.end() ||
+         _preparedConstraints.find( pcn) != _preparedConstraints.end())
+      continue;
+    unmatched.insert( HashToConstraintMap::value_type( pcn->StructuralHash(), pcn));
+    }
+
+  vector<pair<P_Constraint, P_Constraint> > replaced;
+  vector<P_Constraint> toAdd;
+  vector<P_Constraint>::iterator it;
+  for ( it = pending.begin(); it != pending.end(); ++it)
+    {
+    pair<HashToConstraintMap::iterator, HashToConstraintMap::iterator> 
+      range = unmatched.equal_range((*it)->StructuralHash());
+    HashToConstraintMap::iterator it_match = range.first;
+    for ( ; it_match != range.second; ++it_match)
       {
-      VarSet & eVars = (*it_eVars).second;
-      _stayPlusErrorVars
-        .erase( remove_if( _stayPlusErrorVars.begin(),_stayPlusErrorVars.end(),
-                         VarInVarSet( eVars)),
-               _stayPlusErrorVars.end());
-      _stayMinusErrorVars
-        .erase( remove_if( _stayMinusErrorVars.begin(),_stayMinusErrorVars.end(),
-                         VarInVarSet( eVars)),
-               _stayMinusErrorVars.end());
+      if ( (*it_match).second->FIsStructurallyEqual(**it))
+        break;
+      }
+    if ( it_match != range.second)
+      {
+      replaced.push_back( make_pair( (*it_match).second,*it));
+      unmatched.erase( it_match);
+      }
+    else
+      {
+      toAdd.push_back(*it);
       }
     }
-  else if ( pcn->IsEditConstraint())
+
+  vector<P_Constraint> removed;
+  HashToConstraintMap::iterator it_unmatched = unmatched.begin();
+  for ( ; it_unmatched != unmatched.end(); ++it_unmatched)
     {
-    EditConstraint * pcnEdit = dynamic_cast<EditConstraint * >( pcn.ptr());
-    const Variable & clv = pcnEdit->variable();
-    P_EditInfo pcei = PEditInfoFromv( clv);
-    assert( pcei);
-    Variable clvEditMinus = pcei->_clvEditMinus;
-    RemoveColumn( clvEditMinus);  // clvEditPlus is a marker var and gets removed later
-    _editInfoList.remove( pcei);
+    removed.push_back( (*it_unmatched).second);
     }
 
-  if ( fFoundErrorVar)
+  // Hold off optimizing until the tableau has all the changes, and log
+  // them, so that if a constraint cannot be added they can be undone
+  // exactly, leaving the solver as it was
+  bool fAutosolve = _fAutosolve;
+  _fAutosolve = false;
+  BeginTransaction();
+  try
     {
-    // This code is not needed since the variables are deleted
-    // when they are removed from the row --
-    // leaving it in results in double deletions
-    // delete the constraint's error variables
-    //    VarSet & evars_set = (*it_eVars).second;
-    //    VarSet::const_iterator it_set = evars_set.begin();
-    //    for ( ; it_set != evars_set.end(); ++it_set)
-    //      {
-    //      delete * it_set;
-    //      }
-    _errorVars.erase((*it_eVars).first);
+    vector<pair<P_Constraint, P_Constraint> >::iterator it_replaced;
+    for ( it_replaced = replaced.begin(); it_replaced != replaced.end(); ++it_replaced)
+      {
+      ReplaceConstraint( (*it_replaced).first, (*it_replaced).second);
+      }
+    RemoveConstraintsInternal( removed);
+    for ( it = toAdd.begin(); it != toAdd.end(); ++it)
+      {
+      AddConstraint(*it);
+      }
+    }
+  catch ( ... )
+    {
+    RollbackTransaction();
+    _fAutosolve = fAutosolve;
+    throw;
     }
+  CommitTransaction();
 
+  _fAutosolve = fAutosolve;
   if ( _fAutosolve)
     {
-    Optimize( _objective);
+    OptimizeFromBasisCache();
     SetExternalVariables();
     }
+  if ( _fRemoveUnusedVariablesAutomatically) 
+    RemoveUnusedVariableCandidates();
+  return *this;
+}
+
+// Undo pcn's being added to or removed from a solver
+class SimplexSolver::ConstraintJournalEntry : public Journal::Entry {
+ public:
+  ConstraintJournalEntry( SimplexSolver & solver, P_Constraint pcn, bool fAdded)
+      : _solver( solver), _pcn( pcn), _fAdded( fAdded)
+    { }
+  void Undo()
+    {
+    if ( _fAdded)
+      _pcn->removedFrom( _solver);
+    else
+      _pcn->addedTo( _solver);
+    }
+ private:
+  SimplexSolver & _solver;
+  P_Constraint _pcn;
+  bool _fAdded;
+};
+
+// Undo a Changev() or UpdateValues(), telling the callback as it did
+class SimplexSolver::ValueJournalEntry : public Journal::Entry {
+ public:
+  ValueJournalEntry( SimplexSolver & solver, const Variable & v)
+      : _solver( solver), _v( v), _value( v.Value())
+    { }
+  void Undo()
+    { _solver.WriteValue( _v, _value); }
+ private:
+  SimplexSolver & _solver;
+  Variable _v;
+  Number _value;
+};
+
+SimplexSolver &
+SimplexSolver::BeginTransaction()
+{
+  _transactionMarks.push_back( BeginJournal());
+  return *this;
+}
 
+SimplexSolver &
+SimplexSolver::CommitTransaction()
+{
+  if ( _transactionMarks.empty())
+    throw ExCLTransactionMisuse("CommitTransaction called, but no transaction is open");
+  _transactionMarks.pop_back();
+  CommitJournal();
+  return *this;
+}
+
+SimplexSolver &
+SimplexSolver::RollbackTransaction()
+{
+  if ( _transactionMarks.empty())
+    throw ExCLTransactionMisuse("RollbackTransaction called, but no transaction is open");
+  size_t cEntries = _transactionMarks.back();
+  _transactionMarks.pop_back();
+  RollbackJournal( cEntries);
   return *this;
 }
 
+void
+SimplexSolver::NoteConstraintAdded( P_Constraint pcn)
+{
+  pcn->addedTo(*this);
+  if ( _pjournal)
+    _pjournal->Add( new ConstraintJournalEntry(*this, pcn, true));
+}
+
+void
+SimplexSolver::NoteConstraintRemoved( P_Constraint pcn)
+{
+  pcn->removedFrom(*this);
+  if ( _pjournal)
+    _pjournal->Add( new ConstraintJournalEntry(*this, pcn, false));
+}
+
+size_t
+SimplexSolver::BeginJournal()
+{
+  // the caches are not logged, so start them afresh
+  CatchUpTableau();
+  ClearRegionCache();
+  SetJournal( &_journal);
+  size_t cEntries = _journal.CEntries();
+  _journal.SaveValue( _slackCounter);
+  _journal.SaveValue( _artificialCounter);
+  _journal.SaveValue( _dummyCounter);
+  _journal.SaveValue( _activeFingerprint);
+  _journal.SaveValue( _fNeedsSolving);
+  _journal.SaveValue( _fExternalValuesInSync);
+  _journal.SaveValue( _fRegionRecorded);
+  _journal.SaveValue( _infeasibleRows);
+  _journal.SaveValue( _editedExternalRows);
+  _journal.SaveValue( _unusedVarCandidates);
+  return cEntries;
+}
+
+void
+SimplexSolver::CommitJournal()
+{
+  if (!_transactionMarks.empty())
+    return;
+  _journal.ForgetFrom( 0);
+  SetJournal( NULL);
+  _satChangesLogged.clear();
+}
+
+void
+SimplexSolver::RollbackJournal( size_t cEntries)
+{
+  // ( undoing a Changev() calls it again, which must not be logged)
+  SetJournal( NULL);
+  _journal.RollbackTo( cEntries);
+  if (!_transactionMarks.empty())
+    SetJournal( &_journal);
+  else
+    _journal.ForgetFrom( 0);
+  if (!_satChangesLogged.empty())
+    ReportRolledBackSatisfaction();
+}
+
+void
+SimplexSolver::CheckNoTransaction( const char * szWhat) const
+{
+  if (!_transactionMarks.empty())
+    throw ExCLTransactionMisuse( string( szWhat) + " cannot be done in a transaction");
+}
+
+void
+SimplexSolver::JournalValue( const Variable & v)
+{
+  _pjournal->Add( new ValueJournalEntry(*this, v));
+}
 
 // Re-initialize this solver from the original constraints, thus
 // getting rid of any accumulated numerical problems.  ( Actually,
@@ -673,38 +3129,117 @@ SimplexSolver::Reset()
 void 
 SimplexSolver::Resolve()
 { // CODE DUPLICATED ABOVE
+  CheckNoTransaction("Resolve");
 #ifdef CL_TRACE
   Tracer TRACER( __FUNCTION__);
 #endif
-  DualOptimize();
-  SetExternalVariables();
+  if ( _infeasibleRows.empty() && _fExternalValuesInSync && !_fNeedsSolving)
+    {
+    // Every suggested value is within its EditRange, so the basis is
+    // still feasible, and ( only constants having changed) optimal.
+    // The new values are just the edited rows' constants.
+    SetEditedExternalVariables();
+    if ( FIsRegionCaching() && !_fRegionRecorded)
+      RecordRegion();
+    }
+  else if ( FIsRegionCaching() && FResolveFromRegionCache())
+    {
+    // the infeasible rows are kept for CatchUpTableau
+    return;
+    }
+  else
+    {
+    bool fCaching = FIsRegionCaching();
+    _fTableauBehind = false;
+    DualOptimize();
+    SetExternalVariables();
+    if ( fCaching)
+      {
+      ++_cRegionCacheMisses;
+      RecordRegion();
+      }
+    }
   _infeasibleRows.clear();
   if ( _fResetStayConstantsAutomatically)
     ResetStayConstants();
 }
 
-SimplexSolver & 
-SimplexSolver::SuggestValue( const Variable & v, Number x)
+SimplexSolver & 
+SimplexSolver::SuggestValue( const Variable & v, Number x)
+{
+  CheckNoTransaction("SuggestValue");
+#ifdef CL_TRACE
+  Tracer TRACER( __FUNCTION__);
+#endif
+  P_EditInfo pcei = PEditInfoFromv( v);
+  if ( NULL == pcei)
+    {
+#ifndef CL_NO_IO
+    ostringstream ss;
+    ss << "SuggestValue for variable " << v << ", but var is not an edit variable" << ends;
+    throw ExCLEditMisuse( ss.str() );
+#else
+    throw ExCLEditMisuse( v.Name() );
+#endif
+    }
+  Variable clvEditPlus = pcei->_clvEditPlus;
+  Variable clvEditMinus = pcei->_clvEditMinus;
+  Number delta = x - pcei->_prevEditConstant;
+  pcei->_prevEditConstant = x;
+  DeltaEditConstant( delta,clvEditPlus,clvEditMinus);
+  return *this;
+}
+
+ClStatus
+SimplexSolver::TrySuggestValue( const Variable & v, Number x)
+{
+  if ( FInTransaction())
+    return clsTransactionMisuse;
+  if ( NULL == PEditInfoFromv( v))
+    return clsEditMisuse;
+  SuggestValue( v, x);
+  return clsOk;
+}
+
+SimplexSolver::EditHandle
+SimplexSolver::EditHandleFor( const Variable & v)
 {
-#ifdef CL_TRACE
-  Tracer TRACER( __FUNCTION__);
-#endif
   P_EditInfo pcei = PEditInfoFromv( v);
   if ( NULL == pcei)
     {
 #ifndef CL_NO_IO
     ostringstream ss;
-    ss << "SuggestValue for variable " << v << ", but var is not an edit variable" << ends;
+    ss << "EditHandleFor variable " << v << ", but var is not an edit variable" << ends;
     throw ExCLEditMisuse( ss.str() );
 #else
     throw ExCLEditMisuse( v.Name() );
 #endif
     }
-  Variable clvEditPlus = pcei->_clvEditPlus;
-  Variable clvEditMinus = pcei->_clvEditMinus;
-  Number delta = x - pcei->_prevEditConstant;
-  pcei->_prevEditConstant = x;
-  DeltaEditConstant( delta,clvEditPlus,clvEditMinus);
+  return pcei;
+}
+
+SimplexSolver & 
+SimplexSolver::SuggestValues( const EditHandle * handles, const Number * values,
+                              size_t n)
+{
+  CheckNoTransaction("SuggestValues");
+#ifdef CL_TRACE
+  Tracer TRACER( __FUNCTION__);
+#endif
+  size_t i;
+  for ( i = 0; i < n; ++i)
+    {
+    if (!handles[i] || !handles[i]->_fInUse)
+      throw ExCLEditMisuse("SuggestValues given the handle of an edit that has ended");
+    }
+  for ( i = 0; i < n; ++i)
+    {
+    const P_EditInfo & pcei = handles[i];
+    Number delta = values[i] - pcei->_prevEditConstant;
+    pcei->_prevEditConstant = values[i];
+    DeltaEditConstant( delta,pcei->_clvEditPlus,pcei->_clvEditMinus);
+    }
+  Resolve();
   return *this;
 }
 
@@ -734,7 +3269,7 @@ SimplexSolver & SimplexSolver::Solve() {
 #endif
     if ( _fNeedsSolving) 
       {
-      Optimize( _objective);
+      OptimizeFromBasisCache();
       SetExternalVariables();
 #ifdef CL_TRACE_VERBOSE
       cout << "Manual solve actually solving." << endl;
@@ -745,11 +3280,12 @@ SimplexSolver & SimplexSolver::Solve() {
 SimplexSolver & SimplexSolver::SetEditedValue( Variable v, double n) {
     if (!FContainsVariable( v))
       {
-      Changev( v,n);
+      WriteValue( v,n);
       return *this;
       }
 
-    if (!Approx( n, v.Value())) 
+    CatchUpTableau();
+    if (!Approx( n, SolvedValue( v))) 
       {
       AddEditVar( v);
       BeginEdit();
@@ -764,10 +3300,10 @@ SimplexSolver & SimplexSolver::SetEditedValue( Variable v, double n) {
 // Add the constraint expr=0 to the inequality tableau using an
 // artificial variable.  To do this, create an artificial variable
 // av and Add av=expr to the inequality tableau, then make av be 0.
-// ( Raise an exception if we can't attain av=0 -- and prepare explanation)
+// ( Return false if we can't attain av=0 -- and prepare explanation)
 bool
 SimplexSolver::AddWithArtificialVariable( P_LinearExpression expr,
-                                           ExCLRequiredFailureWithExplanation & e)
+                                           ConstraintSet * pexplanation)
 {
 #ifdef CL_TRACE
   Tracer TRACER( __FUNCTION__);
@@ -779,28 +3315,11 @@ SimplexSolver::AddWithArtificialVariable( P_LinearExpression expr,
   // and that will result in the destructor cleaning up
   // after us
   P_AbstractVariable pav = new SlackVariable(++_artificialCounter,"a");
-  P_AbstractVariable paz = new ObjectiveVariable("az");
-  P_LinearExpression pazRow = new LinearExpression( *expr); //copy
-  // the artificial objective is av, which we know is equal to expr
-  // ( which contains only parametric variables)
 
 #ifdef CL_FIND_LEAK
   cout << "aC = " << _artificialCounter
        << "\nDeletes = " << _cArtificialVarsDeleted << endl;
 #endif
-#ifdef CL_TRACE
-  cout << __FUNCTION__ << " before addRow-s:\n"
-       << (*this) << endl;
-#endif
-
-  // the artificial objective is av, which we know is equal to expr
-  // ( which contains only parametric variables)
-  
-  // objective is treated as a row in the tableau,
-  // so do the substitution for its value ( we are minimizing
-  // the artificial variable)
-  // this row will be removed from the tableau after optimizing
-  addRow(*paz,pazRow);
   
   // now Add the normal row to the tableau -- when artifical
   // variable is minimized to 0 ( if possible)
@@ -808,39 +3327,70 @@ SimplexSolver::AddWithArtificialVariable( P_LinearExpression expr,
   // we are trying to Add
   addRow(*pav,expr);
 
+  return RemoveArtificialVariable(*pav, true, pexplanation);
+}
+
+// Make the artificial variable av, which the tableau has as the subject
+// of a row, be 0 and then take it out of the tableau again.  Unless
+// fMinimize is false ( av is known to be 0 already), this optimizes an
+// artificial objective equal to av.  Return false, with an explanation
+// in *pexplanation ( if given), if av cannot be made 0.
+bool
+SimplexSolver::RemoveArtificialVariable( const Variable & av, bool fMinimize,
+                                         ConstraintSet * pexplanation)
+{
+#ifdef CL_TRACE
+  Tracer TRACER( __FUNCTION__);
+  cout << "(" << av << ")" << endl;
+#endif
+  P_LinearExpression pe = ConstRowExpression( av);
+  if ( fMinimize && pe != NULL)
+    {
+    P_AbstractVariable paz = new ObjectiveVariable("az");
+    P_LinearExpression pazRow = new LinearExpression( *pe); //copy
+
+    // the artificial objective is av, which we know is equal to its
+    // row ( which contains only parametric variables)
+  
+    // objective is treated as a row in the tableau,
+    // so do the substitution for its value ( we are minimizing
+    // the artificial variable)
+    // this row will be removed from the tableau after optimizing
+    addRow(*paz,pazRow);
+
 #ifdef CL_TRACE
-  cout << __FUNCTION__ << " after addRow-s:\n"
-       << (*this) << endl;
+    cout << __FUNCTION__ << " after addRow-s:\n"
+         << (*this) << endl;
 #endif
 
-  // try to Optimize az to 0
-  // note we are * not* optimizing the real objective, but optimizing
-  // the artificial objective to see if the error in the constraint
-  // we are adding can be set to 0
-  Optimize(*paz);
+    // try to Optimize az to 0
+    // note we are * not* optimizing the real objective, but optimizing
+    // the artificial objective to see if the error in the constraint
+    // we are adding can be set to 0
+    Optimize(*paz);
 
-  // Careful, we want to get the Expression that is in
-  // the tableau, not the one we initialized it with!
-  P_LinearExpression pazTableauRow = RowExpression(*paz);
+    // Careful, we want to get the Expression that is in
+    // the tableau, not the one we initialized it with!
+    P_LinearExpression pazTableauRow = ConstRowExpression(*paz);
 #ifdef CL_TRACE
-  cout << "pazTableauRow->Constant() == " << pazTableauRow->Constant() << endl;
+    cout << "pazTableauRow->Constant() == " << pazTableauRow->Constant() << endl;
 #endif
 
-  // Check that we were able to make the objective value 0
-  // If not, the original constraint was not satisfiable
-  if (!Approx( pazTableauRow->Constant(),0.0))
-    {
-    BuildExplanation( e, paz.ptr(), pazTableauRow);
+    // Check that we were able to make the objective value 0
+    // If not, the original constraint was not satisfiable
+    bool fZero = Approx( pazTableauRow->Constant(),0.0);
+    if (!fZero && pexplanation)
+      BuildExplanation( *pexplanation, paz.ptr(), pazTableauRow);
     // remove the artificial objective row that we just
-    // added temporarily
-        RemoveRow(*paz);
-    // and the artificial objective variable that we also added above 
+    // added temporarily; the artificial objective variable 
     // will die as well
-    return false;
+    RemoveRow(*paz);
+    if (!fZero)
+      return false;
+    pe = ConstRowExpression( av);
     }
 
   // see if av is a basic variable
-  P_LinearExpression pe = RowExpression(*pav);
   if ( pe != NULL)
     {
     // FIXGJB: do we ever even get here?
@@ -851,9 +3401,7 @@ SimplexSolver::AddWithArtificialVariable( P_LinearExpression expr,
       {
       // FIXGJB: do we ever get here?
       assert( Approx( pe->Constant(),0.0));
-          RemoveRow(*pav);
-      // remove the temporary objective function
-      // FIXGJB may need this too: delete RemoveRow(*paz);
+          RemoveRow( av);
 #ifdef CL_FIND_LEAK
       ++_cArtificialVarsDeleted;
 #endif
@@ -862,19 +3410,18 @@ SimplexSolver::AddWithArtificialVariable( P_LinearExpression expr,
     Variable entryVar = pe->AnyPivotableVariable();
     if ( entryVar.IsNil())
       {
-      BuildExplanation( e, * pav, pe);
+      if ( pexplanation)
+        BuildExplanation( *pexplanation, av, pe);
       return false; /* required failure */
       }
-    Pivot( entryVar, * pav);
+    Pivot( entryVar, av);
     }
   // now av should be parametric
-  assert( RowExpression(*pav) == NULL);
-  RemoveColumn(*pav);
+  assert( RowExpression( av) == NULL);
+  RemoveColumn( av);
 #ifdef CL_FIND_LEAK
   ++_cArtificialVarsDeleted;
 #endif
-  // remove the temporary objective function
-      RemoveRow(*paz);
   return true;
 }
 
@@ -882,7 +3429,7 @@ SimplexSolver::AddWithArtificialVariable( P_LinearExpression expr,
 // Using the given equation ( av = cle) build an explanation which
 // implicates all constraints used to construct the equation. That
 // is, everything for which the variables in the equation are markers.
-void SimplexSolver::BuildExplanation( ExCLRequiredFailureWithExplanation & e,
+void SimplexSolver::BuildExplanation( ConstraintSet & explanation,
                                        Variable av,
                                        P_LinearExpression pcle)
 {
@@ -890,7 +3437,7 @@ void SimplexSolver::BuildExplanation( ExCLRequiredFailureWithExplanation & e,
   it_cn = _constraintsMarked.find( av);
   if ( it_cn != _constraintsMarked.end()) 
     {
-      e.AddConstraint((*it_cn).second);
+      explanation.insert((*it_cn).second);
     }
   
   assert( pcle != NULL);
@@ -902,25 +3449,144 @@ void SimplexSolver::BuildExplanation( ExCLRequiredFailureWithExplanation & e,
     it_cn = _constraintsMarked.find((*it_term).first);
     if ( it_cn != _constraintsMarked.end()) 
       {
-      e.AddConstraint((*it_cn).second);
+      explanation.insert((*it_cn).second);
+      }
+    }
+}
+
+
+
+// Find an irreducible conflict among the required constraints that
+// explanation names ( or, if it is empty, all those in the solver) and
+// pcn, by QuickXplain.  In a transaction, take out all the required
+// constraints, so that those not named cannot take part unseen, add
+// pcn, and then add the named ones back in halves, rolling back after
+// each trial, to find which are needed for the failure.  The
+// transaction is rolled back at the end, so the solver is left as it
+// was.
+void
+SimplexSolver::MinimizeExplanation( P_Constraint pcn, ConstraintSet & explanation)
+{
+#ifdef CL_TRACE
+  Tracer TRACER( __FUNCTION__);
+  cout << "(" << * pcn << ")" << endl;
+#endif
+  // the required constraints: all of them, and those to look in
+  vector<P_Constraint> required;
+  vector<P_Constraint> cns;
+  ConstraintToVarMap::const_iterator it = _markerVars.begin();
+  for ( ; it != _markerVars.end(); ++it)
+    {
+    const P_Constraint & pcnOther = (*it).first;
+    if (!pcnOther->IsRequired() || pcnOther->IsEditConstraint())
+      continue;
+    required.push_back( pcnOther);
+    if ( explanation.empty() || explanation.find( pcnOther) != explanation.end())
+      cns.push_back( pcnOther);
+    }
+  if ( cns.empty())
+    return;
+
+  // the trial adds need not be optimized, nor their variables' stays
+  // dropped when they are taken out again
+  bool fAutosolve = _fAutosolve;
+  bool fRemoveUnused = _fRemoveUnusedVariablesAutomatically;
+  _fAutosolve = false;
+  _fRemoveUnusedVariablesAutomatically = false;
+  vector<P_Constraint> conflict;
+  bool fFound = false;
+  BeginTransaction();
+  try
+    {
+    RemoveConstraintsInternal( required);
+    // pcn must fail along with all of cns, as it did with the rest
+    // there too, else the explanation missed something and cannot be
+    // relied on to find the conflict in
+    if ( TryAddConstraint( pcn) == clsOk)
+      {
+      BeginTransaction();
+      fFound = !FAddedAll( cns);
+      RollbackTransaction();
+      if ( fFound)
+        QuickXplain( cns, conflict);
       }
     }
+  catch ( ... )
+    {
+    RollbackTransaction();
+    _fAutosolve = fAutosolve;
+    _fRemoveUnusedVariablesAutomatically = fRemoveUnused;
+    throw;
+    }
+  RollbackTransaction();
+  _fAutosolve = fAutosolve;
+  _fRemoveUnusedVariablesAutomatically = fRemoveUnused;
+  if (!fFound)
+    return;
+  explanation.clear();
+  explanation.insert( pcn);
+  explanation.insert( conflict.begin(), conflict.end());
 }
 
+// This is QuickXplain ( Junker, 2004) with the background in the
+// solver.  If the solver cannot take the first half of cns as well,
+// the conflict is in that half; otherwise, with it added, find the
+// part of the conflict in the second half, then with that added
+// instead, the part in the first half.
+void
+SimplexSolver::QuickXplain( const vector<P_Constraint> & cns,
+                            vector<P_Constraint> & conflict)
+{
+  if ( cns.size() == 1)
+    {
+    conflict.push_back( cns[0]);
+    return;
+    }
+  size_t cHalf = cns.size() / 2;
+  vector<P_Constraint> cns1( cns.begin(), cns.begin() + cHalf);
+  vector<P_Constraint> cns2( cns.begin() + cHalf, cns.end());
+
+  vector<P_Constraint> conflict2;
+  BeginTransaction();
+  if ( FAddedAll( cns1))
+    QuickXplain( cns2, conflict2);
+  RollbackTransaction();
+
+  vector<P_Constraint> conflict1;
+  BeginTransaction();
+  if ( FAddedAll( conflict2))
+    QuickXplain( cns1, conflict1);
+  RollbackTransaction();
+
+  conflict.insert( conflict.end(), conflict1.begin(), conflict1.end());
+  conflict.insert( conflict.end(), conflict2.begin(), conflict2.end());
+}
 
+bool
+SimplexSolver::FAddedAll( const vector<P_Constraint> & cns)
+{
+  vector<P_Constraint>::const_iterator it = cns.begin();
+  for ( ; it != cns.end(); ++it)
+    {
+    if ( TryAddConstraint(*it) != clsOk)
+      return false;
+    }
+  return true;
+}
 
 // We are trying to Add the constraint expr=0 to the appropriate
 // tableau.  Try to Add expr directly to the tableaus without
 // creating an artificial variable.  Return true if successful and
 // false if not.
 bool 
-SimplexSolver::TryAddingDirectly( P_LinearExpression expr) 
+SimplexSolver::TryAddingDirectly( P_LinearExpression expr, ClStatus & status,
+                                  ConstraintSet * pexplanation) 
 {
 #ifdef CL_TRACE
   Tracer TRACER( __FUNCTION__);
   cout << "(" << *expr << ")" << endl;
 #endif
-  Variable subject = ChooseSubject( expr);
+  Variable subject = ChooseSubject( expr, status, pexplanation);
   if ( subject.get_pclv() == NULL )
     {
 #ifdef CL_TRACE
@@ -960,7 +3626,8 @@ SimplexSolver::TryAddingDirectly( P_LinearExpression expr)
 // new slack variables are added to the objective function by
 // 'NewExpression:', which is called before this method.
 Variable
-SimplexSolver::ChooseSubject( P_LinearExpression expr)
+SimplexSolver::ChooseSubject( P_LinearExpression expr, ClStatus & status,
+                              ConstraintSet * pexplanation)
 {
 #ifdef CL_TRACE
   Tracer TRACER( __FUNCTION__);
@@ -1063,14 +3730,10 @@ SimplexSolver::ChooseSubject( P_LinearExpression expr)
     cout << "required failure in choose subject:\n"
          << *this << endl;
 #endif
-    if ( FIsExplaining()) 
-      {
-      ExCLRequiredFailureWithExplanation e;
-      BuildExplanation( e, clvNil, expr);
-      throw e;
-      }
-    else
-      throw ExCLRequiredFailure();
+    if ( pexplanation)
+      BuildExplanation( *pexplanation, clvNil, expr);
+    status = clsRequiredFailure;
+    return clvNil;
     }
   if ( coeff > 0.0)
     {
@@ -1108,6 +3771,8 @@ SimplexSolver::DeltaEditConstant( Number delta,
   P_LinearExpression pexprPlus = RowExpression( plusErrorVar);
   if ( pexprPlus != NULL )
     {
+    // ( error variables are never external, so no external values change)
+    NoteRowTouched( plusErrorVar);
     pexprPlus->IncrementConstant( delta);
     // error variables are always restricted
     // so the row is infeasible if the Constant is negative
@@ -1121,6 +3786,7 @@ SimplexSolver::DeltaEditConstant( Number delta,
   P_LinearExpression pexprMinus = RowExpression( minusErrorVar);
   if ( pexprMinus != NULL)
     {
+    NoteRowTouched( minusErrorVar);
     pexprMinus->IncrementConstant(-delta);
     if ( pexprMinus->Constant() < 0.0)
       {
@@ -1141,12 +3807,230 @@ SimplexSolver::DeltaEditConstant( Number delta,
     P_LinearExpression pexpr = RowExpression( basicVar);
     assert( pexpr != NULL );
     double c = pexpr->CoefficientFor( minusErrorVar);
+    NoteRowTouched( basicVar);
     pexpr->IncrementConstant( c*delta);
     if ( basicVar.IsRestricted() && pexpr->Constant() < 0.0)
       {
       _infeasibleRows.insert( basicVar);
       }
+    else if ( _fExternalValuesInSync && basicVar.IsExternal())
+      {
+      _editedExternalRows.insert( basicVar);
+      }
+    }
+}
+
+void
+SimplexSolver::EditRowRates( P_EditInfo pcei, VarToNumberMap & rowRates)
+{
+  CatchUpTableau();
+  if ( FIsBasicVar( pcei->_clvEditPlus))
+    {
+    rowRates[pcei->_clvEditPlus] = 1.0;
+    return;
+    }
+  if ( FIsBasicVar( pcei->_clvEditMinus))
+    {
+    rowRates[pcei->_clvEditMinus] = -1.0;
+    return;
+    }
+  const VarSet & columnVars = ConstColumn( pcei->_clvEditMinus);
+  VarSet::const_iterator it = columnVars.begin();
+  for (; it != columnVars.end(); ++it)
+    {
+    rowRates[*it] = ConstRowExpression(*it)->CoefficientFor( pcei->_clvEditMinus);
+    }
+}
+
+void
+SimplexSolver::EditSensitivity( const Variable & v, VarToNumberMap & rates)
+{
+  VarToNumberMap rowRates;
+  EditRowRates( EditHandleFor( v), rowRates);
+  VarToNumberMap::const_iterator it = rowRates.begin();
+  for ( ; it != rowRates.end(); ++it)
+    {
+    if ( (*it).first.IsExternal() && (*it).first != _objective)
+      rates[(*it).first] = (*it).second;
+    }
+}
+
+void
+SimplexSolver::EditRange( const Variable & v, Number & lower, Number & upper)
+{
+  P_EditInfo pcei = EditHandleFor( v);
+  VarToNumberMap rowRates;
+  EditRowRates( pcei, rowRates);
+  lower = -DBL_MAX;
+  upper = DBL_MAX;
+  // each restricted row needs constant + rate * ( x - prev) >= 0
+  VarToNumberMap::const_iterator it = rowRates.begin();
+  for ( ; it != rowRates.end(); ++it)
+    {
+    const Variable & basicVar = (*it).first;
+    Number rate = (*it).second;
+    if (!basicVar.IsRestricted() || Approx( rate, 0.0))
+      continue;
+    Number bound = pcei->_prevEditConstant - ConstRowExpression( basicVar)->Constant() / rate;
+    if ( rate > 0.0 && bound > lower)
+      lower = bound;
+    else if ( rate < 0.0 && bound < upper)
+      upper = bound;
+    }
+}
+  
+SimplexSolver &
+SimplexSolver::SetRegionCacheLimit( size_t n)
+{
+  if ( n > 0 && ( _fResetStayConstantsAutomatically || !_fWritesVariables ||
+                  _fTracksSatisfaction))
+    throw ExCLTooDifficultSpecial("The region cache needs SetAutoResetStayConstants(false), "
+                                  "variables written and no satisfaction tracking");
+  _cRegionCacheLimit = n;
+  while ( _regions.size() > n)
+    _regions.pop_back();
+  return *this;
+}
+
+void
+SimplexSolver::RecordRegion()
+{
+#ifdef CL_TRACE
+  Tracer TRACER( __FUNCTION__);
+#endif
+  _fRegionRecorded = true;
+  vector<P_EditInfo> edits;
+  EditInfoList::const_iterator it_edit = _editInfoList.begin();
+  for ( ; it_edit != _editInfoList.end(); ++it_edit)
+    {
+    // ( skipping the partial entries of variables edited twice)
+    if (!(*it_edit)->_clvEditPlus.IsNil())
+      edits.push_back(*it_edit);
+    }
+  size_t cEdits = edits.size();
+  if ( cEdits == 0)
+    return;
+
+  _regions.push_front( CriticalRegion());
+  CriticalRegion & region = _regions.front();
+  vector<VarToNumberMap> rowRates( cEdits);
+  VarSet touchedRows;
+  size_t i;
+  for ( i = 0; i < cEdits; ++i)
+    {
+    region._editValues.push_back( edits[i]->_prevEditConstant);
+    EditRowRates( edits[i], rowRates[i]);
+    VarToNumberMap::const_iterator it = rowRates[i].begin();
+    for ( ; it != rowRates[i].end(); ++it)
+      touchedRows.insert( (*it).first);
+    }
+
+  // the restricted rows that the edits move are the region's bounds,
+  // and the external rows they move get rates
+  VarSet::const_iterator it_row = touchedRows.begin();
+  for ( ; it_row != touchedRows.end(); ++it_row)
+    {
+    const Variable & basicVar = *it_row;
+    vector<Number> * plaw;
+    if ( basicVar.IsRestricted())
+      plaw = &region._rowBounds;
+    else if ( basicVar.IsExternal() && basicVar != _objective)
+      {
+      plaw = &region._varLaws;
+      region._vars.push_back( basicVar);
+      }
+    else
+      continue;
+    plaw->push_back( ConstRowExpression( basicVar)->Constant());
+    for ( i = 0; i < cEdits; ++i)
+      {
+      VarToNumberMap::const_iterator it = rowRates[i].find( basicVar);
+      plaw->push_back( it != rowRates[i].end()? (*it).second : 0.0);
+      }
+    }
+
+  // the rest of the external variables are constant in the region
+  VarSet::const_iterator it_var = _externalRows.begin();
+  for ( ; it_var != _externalRows.end(); ++it_var)
+    {
+    if ( touchedRows.find(*it_var) != touchedRows.end())
+      continue;
+    region._vars.push_back(*it_var);
+    region._varLaws.push_back( ConstRowExpression(*it_var)->Constant());
+    region._varLaws.insert( region._varLaws.end(), cEdits, 0.0);
+    }
+  it_var = _externalParametricVars.begin();
+  for ( ; it_var != _externalParametricVars.end(); ++it_var)
+    {
+    region._vars.push_back(*it_var);
+    region._varLaws.insert( region._varLaws.end(), cEdits + 1, 0.0);
+    }
+
+  if ( _regions.size() > _cRegionCacheLimit)
+    _regions.pop_back();
+}
+
+bool
+SimplexSolver::FResolveFromRegionCache()
+{
+#ifdef CL_TRACE
+  Tracer TRACER( __FUNCTION__);
+#endif
+  vector<Number> editValues;
+  EditInfoList::const_iterator it_edit = _editInfoList.begin();
+  for ( ; it_edit != _editInfoList.end(); ++it_edit)
+    {
+    if (!(*it_edit)->_clvEditPlus.IsNil())
+      editValues.push_back( (*it_edit)->_prevEditConstant);
+    }
+  size_t cEdits = editValues.size();
+  vector<Number> deltas( cEdits);
+
+  CriticalRegionList::iterator it = _regions.begin();
+  for ( ; it != _regions.end(); ++it)
+    {
+    CriticalRegion & region = *it;
+    if ( region._editValues.size() != cEdits)
+      continue;
+    size_t i, j;
+    for ( j = 0; j < cEdits; ++j)
+      deltas[j] = editValues[j] - region._editValues[j];
+    bool fInside = true;
+    for ( i = 0; fInside && i < region._rowBounds.size(); i += cEdits + 1)
+      {
+      Number c = region._rowBounds[i];
+      for ( j = 0; j < cEdits; ++j)
+        c += region._rowBounds[i + 1 + j] * deltas[j];
+      fInside = ( c >= -_epsilon);
+      }
+    if (!fInside)
+      continue;
+
+    ++_cRegionCacheHits;
+    ++_cSolutions;
+    _changedVars.clear();
+    _snappedValues.clear();
+    if ( it != _regions.begin())
+      _regions.splice( _regions.begin(), _regions, it);
+    const vector<Number> & laws = region._varLaws;
+    for ( i = 0; i < region._vars.size(); ++i)
+      {
+      const Number * plaw = &laws[i * (cEdits + 1)];
+      Number value = plaw[0];
+      for ( j = 0; j < cEdits; ++j)
+        value += plaw[1 + j] * deltas[j];
+      Changev( region._vars[i], value);
+      }
+    _fTableauBehind = true;
+    _fExternalValuesInSync = false;
+    _editedExternalRows.clear();
+    if ( _pfnChangesCallback && !_changedVars.empty())
+      _pfnChangesCallback( this, _changedVars);
+    if ( _pfnResolveCallback)
+      _pfnResolveCallback( this);
+    return true;
     }
+  return false;
 }
   
 // We have set new values for the constants in the edit constraints.
@@ -1223,20 +4107,71 @@ P_LinearExpression SimplexSolver::NewExpression( P_Constraint pcn,
   cout << "cn.IsInequality() == " << pcn->IsInequality() << endl;
   cout << "cn.IsRequired() == " << pcn->IsRequired() << endl;
 #endif
-  LinearExpression cnExpr = pcn->Expression();
+  CatchUpTableau();
+  ClearRegionCache();
+  // A grouped constraint brings its expression along, and possibly the
+  // variables made the last time its group was active
+  PreparedConstraint * pprep = NULL;
+  if (!_preparedConstraints.empty())
+    {
+    PreparedConstraintMap::iterator it_prep = _preparedConstraints.find( pcn);
+    if ( it_prep != _preparedConstraints.end())
+      {
+      JournalEntry( _preparedConstraints, pcn);
+      pprep = &(*it_prep).second;
+      if ( pprep->_fRequired != pcn->IsRequired())
+        {
+        // the strength changed while inactive, so the kind of marker did too
+        pprep->_clvMarker = clvNil;
+        pprep->_clvEminus = clvNil;
+        pprep->_fRequired = pcn->IsRequired();
+        }
+      }
+    }
+  LinearExpression cnExprCopy;
+  if (!pprep)
+    {
+    cnExprCopy = pcn->Expression();
+    // a stay or edit is made at v's value, which v itself does not
+    // have when the solver does not write it
+    if ( pcn->isStayConstraint() || pcn->IsEditConstraint())
+      {
+      EditOrStayConstraint * pcnEoS = dynamic_cast<EditOrStayConstraint * >( pcn.ptr());
+      cnExprCopy.Set_constant( SolvedValue( pcnEoS->variable()));
+      }
+    }
+  const LinearExpression & cnExpr = pprep? pprep->_expression : cnExprCopy;
         
   P_LinearExpression pexpr( new LinearExpression( cnExpr.Constant()));
   P_AbstractVariable pslackVar;
   P_AbstractVariable pdummyVar;
   P_AbstractVariable peminus;
   P_AbstractVariable peplus;
+  Variable clvPrepMarker = pprep? ReusableVariable( pprep->_clvMarker) : clvNil;
+  Variable clvPrepEminus = pprep? ReusableVariable( pprep->_clvEminus) : clvNil;
+
+  // Stays and edits do not keep a variable in use; every other
+  // constraint counts once for each variable it mentions
+  bool fCountUses = !pcn->isStayConstraint() && !pcn->IsEditConstraint();
+  if ( pcn->isStayConstraint())
+    {
+    StayConstraint * pcnStay = dynamic_cast<StayConstraint * >( pcn.ptr());
+    JournalEntry( _stayConstraints, pcnStay->variable());
+    _stayConstraints[pcnStay->variable()].insert( pcn);
+    }
+
   const VarToNumberMap & cnTerms = cnExpr.Terms();
   VarToNumberMap::const_iterator it = cnTerms.begin();
   for ( ; it != cnTerms.end(); ++it)
     {
     Variable v = (*it).first;
     Number c = (*it).second;
-    P_LinearExpression pe = RowExpression( v);
+    if ( fCountUses)
+      {
+      JournalEntry( _varUseCounts, v);
+      ++_varUseCounts[v];
+      }
+    P_LinearExpression pe = ConstRowExpression( v);
     if ( pe == NULL)
       {
       pexpr->AddVariable( v,c);
@@ -1258,24 +4193,40 @@ P_LinearExpression SimplexSolver::NewExpression( P_Constraint pcn,
     //    expr-slackVar+errorVar=0.
     // Since both of these variables are newly created we can just Add
     // them to the Expression ( they can't be basic).
-    ++_slackCounter;
-    pslackVar = new SlackVariable( _slackCounter, "s");
+    if (!clvPrepMarker.IsNil())
+      pslackVar = clvPrepMarker.get_pclv();
+    else
+      {
+      ++_slackCounter;
+      pslackVar = new SlackVariable( _slackCounter, "s");
+      }
     pexpr->setVariable(*pslackVar,-1);
     // index the constraint under its slack variable and vice-versa
+    JournalEntry( _markerVars, pcn);
+    JournalEntry( _constraintsMarked, pslackVar);
     _markerVars[pcn] = pslackVar;
     _constraintsMarked[pslackVar] = pcn;
     
     if (!pcn->IsRequired())
       {
-      ++_slackCounter;
-      peminus = new SlackVariable( _slackCounter, "em");
+      if (!clvPrepEminus.IsNil())
+        peminus = clvPrepEminus.get_pclv();
+      else
+        {
+        ++_slackCounter;
+        peminus = new SlackVariable( _slackCounter, "em");
+        }
       pexpr->setVariable( peminus,1.0);
       // Add emnius to the objective function with the appropriate weight
       P_LinearExpression pzRow = RowExpression( _objective);
       // FIXGJB: pzRow->AddVariable( eminus,pcn->strength().symbolicWeight() * pcn->weight());
       SymbolicWeight sw = pcn->strength().symbolicWeight().Times( pcn->weight());
+      JournalTerms( pzRow, peminus);
       pzRow->setVariable( peminus,sw.AsDouble());
+      JournalEntry( _errorVars, pcn);
       _errorVars[pcn].insert( peminus);
+      NoteErrorVarsAdded( pcn);
+      NoteErrorWeight( pcn, sw.AsDouble());
       NoteAddedVariable( peminus,_objective);
       }
     }
@@ -1286,9 +4237,16 @@ P_LinearExpression SimplexSolver::NewExpression( P_Constraint pcn,
       // Add a dummy variable to the Expression to serve as a marker
       // for this constraint.  The dummy variable is never allowed to
       // enter the basis when pivoting.
-      ++_dummyCounter;
-      pdummyVar = new DummyVariable( _dummyCounter, "d");
+      if (!clvPrepMarker.IsNil())
+        pdummyVar = clvPrepMarker.get_pclv();
+      else
+        {
+        ++_dummyCounter;
+        pdummyVar = new DummyVariable( _dummyCounter, "d");
+        }
       pexpr->setVariable( pdummyVar,1.0);
+      JournalEntry( _markerVars, pcn);
+      JournalEntry( _constraintsMarked, pdummyVar);
       _markerVars[pcn] = pdummyVar;
       _constraintsMarked[pdummyVar] = pcn;
 #ifdef CL_TRACE
@@ -1301,13 +4259,23 @@ P_LinearExpression SimplexSolver::NewExpression( P_Constraint pcn,
       // error variable, making the resulting constraint 
       //       expr = eplus - eminus, 
       // in other words:  expr-eplus+eminus=0
-      ++_slackCounter;
-      peplus  = new SlackVariable( _slackCounter, "ep");
-      peminus = new SlackVariable( _slackCounter, "em");
+      if (!clvPrepMarker.IsNil() && !clvPrepEminus.IsNil())
+        {
+        peplus = clvPrepMarker.get_pclv();
+        peminus = clvPrepEminus.get_pclv();
+        }
+      else
+        {
+        ++_slackCounter;
+        peplus  = new SlackVariable( _slackCounter, "ep");
+        peminus = new SlackVariable( _slackCounter, "em");
+        }
 
       pexpr->setVariable( peplus,-1.0);
       pexpr->setVariable( peminus,1.0);
       // index the constraint under one of the error variables
+      JournalEntry( _markerVars, pcn);
+      JournalEntry( _constraintsMarked, peplus);
       _markerVars[pcn] = peplus;
       _constraintsMarked[peplus] = pcn;
 
@@ -1324,15 +4292,25 @@ P_LinearExpression SimplexSolver::NewExpression( P_Constraint pcn,
                          << " with swCoeff == " << swCoeff << endl;
                 }
 #endif      
+      JournalTerms( pzRow, peplus);
       pzRow->setVariable( peplus,swCoeff);
       NoteAddedVariable( peplus,_objective);
       // FIXGJB: pzRow->AddVariable( eminus,pcn->strength().symbolicWeight() * pcn->weight());
+      JournalTerms( pzRow, peminus);
       pzRow->setVariable( peminus,swCoeff);
       NoteAddedVariable( peminus,_objective);
+      JournalEntry( _errorVars, pcn);
       _errorVars[pcn].insert( peminus);
       _errorVars[pcn].insert( peplus);
+      NoteErrorVarsAdded( pcn);
+      NoteErrorWeight( pcn, swCoeff);
       if ( pcn->isStayConstraint()) 
         {
+        if ( _pjournal)
+          {
+          _pjournal->SaveSize( _stayPlusErrorVars);
+          _pjournal->SaveSize( _stayMinusErrorVars);
+          }
         _stayPlusErrorVars.push_back( peplus);
         _stayMinusErrorVars.push_back( peminus);
         }
@@ -1345,6 +4323,14 @@ P_LinearExpression SimplexSolver::NewExpression( P_Constraint pcn,
       }
     }
 
+  _activeFingerprint += FingerprintTerm( _markerVars[pcn], ErrorWeight( pcn));
+
+  if ( pprep)
+    {
+    pprep->_clvMarker = _markerVars[pcn];
+    pprep->_clvEminus = peminus? Variable( peminus) : clvNil;
+    }
+
   // the Constant in the Expression should be non-negative.
   // If necessary normalize the Expression by multiplying by -1
   if ( pexpr->Constant() < 0)
@@ -1410,8 +4396,8 @@ SimplexSolver::Optimize( const Variable & zVar)
     // Only consider pivotable basic variables
     // ( i.e. restricted, non-dummy variables)
     double minRatio = DBL_MAX;
-    VarSet & columnVars = _columns[entryVar];
-    VarSet::iterator it_rowvars = columnVars.begin();
+    const VarSet & columnVars = ConstColumn( entryVar);
+    VarSet::const_iterator it_rowvars = columnVars.begin();
     Number r = 0.0;
     for (; it_rowvars != columnVars.end(); ++it_rowvars)
       {
@@ -1421,7 +4407,7 @@ SimplexSolver::Optimize( const Variable & zVar)
 #endif
       if ( v.IsPivotable()) 
         {
-        P_LinearExpression pexpr = RowExpression( v);
+        P_LinearExpression pexpr = ConstRowExpression( v);
         Number coeff = pexpr->CoefficientFor( entryVar);
         // only consider negative coefficients
         if ( coeff < 0.0)
@@ -1438,22 +4424,183 @@ SimplexSolver::Optimize( const Variable & zVar)
           }
         }
       }
-    // If minRatio is still nil at this point, it means that the
-    // objective function is unbounded, i.e. it can become
-    // arbitrarily negative.  This should never happen in this
-    // application.
-    if ( minRatio == DBL_MAX)
+    // If minRatio is still nil at this point, it means that the
+    // objective function is unbounded, i.e. it can become
+    // arbitrarily negative.  This should never happen in this
+    // application.
+    if ( minRatio == DBL_MAX)
+      {
+      ostringstream ss;
+      ss << "objective function is unbounded!" << ends;
+      throw ExCLInternalError( ss.str() );
+      }
+    Pivot( entryVar, exitVar);
+#ifdef CL_TRACE
+    cout << "After Optimize:\n"
+         << *this << endl;
+#endif
+    }
+}
+
+SimplexSolver &
+SimplexSolver::SetBasisCacheLimit( size_t n)
+{
+  _cBasisCacheLimit = n;
+  while ( _bases.size() > n)
+    _bases.pop_back();
+  return *this;
+}
+
+void
+SimplexSolver::OptimizeFromBasisCache()
+{
+  if ( _cBasisCacheLimit > 0)
+    {
+    if ( FRestoreCachedBasis())
+      ++_cBasisCacheHits;
+    else
+      ++_cBasisCacheMisses;
+    }
+  Optimize( _objective);
+  RememberBasis();
+}
+
+void
+SimplexSolver::RememberBasis()
+{
+  if ( _cBasisCacheLimit == 0)
+    return;
+  CatchUpTableau();
+  if (!_infeasibleRows.empty())
+    return;
+  CachedBasisList::iterator it = _bases.begin();
+  for ( ; it != _bases.end(); ++it)
+    {
+    if ( (*it)._fingerprint == _activeFingerprint)
+      {
+      _bases.erase( it);
+      break;
+      }
+    }
+  _bases.push_front( CachedBasis());
+  CachedBasis & basis = _bases.front();
+  basis._fingerprint = _activeFingerprint;
+  basis._basicVars.reserve( _rows.size());
+  TableauRowsMap::const_iterator it_row = _rows.begin();
+  for ( ; it_row != _rows.end(); ++it_row)
+    {
+    if ( (*it_row).first != _objective)
+      basis._basicVars.push_back( (*it_row).first);
+    }
+  if ( _bases.size() > _cBasisCacheLimit)
+    _bases.pop_back();
+}
+
+bool
+SimplexSolver::FRestoreCachedBasis()
+{
+#ifdef CL_TRACE
+  Tracer TRACER( __FUNCTION__);
+#endif
+  CachedBasisList::iterator it = _bases.begin();
+  for ( ; it != _bases.end(); ++it)
+    {
+    if ( (*it)._fingerprint == _activeFingerprint)
+      break;
+    }
+  if ( it == _bases.end())
+    return false;
+  _bases.splice( _bases.begin(), _bases, it);
+  const VarVector & basicVars = _bases.front()._basicVars;
+
+  // ( fingerprints could collide)
+  if ( basicVars.size() + 1 != _rows.size())
+    return false;
+  VarSet target;
+  VarVector::const_iterator it_var = basicVars.begin();
+  for ( ; it_var != basicVars.end(); ++it_var)
+    {
+    if (!FIsBasicVar(*it_var) && !ColumnsHasKey(*it_var))
+      return false;
+    target.insert(*it_var);
+    }
+
+  // Log the pivots, so that if the basis turns out not to be usable
+  // ( after a fingerprint collision, say) the tableau can be put back
+  // for a plain Optimize()
+  size_t cEntries = BeginJournal();
+  try
+    {
+    // Bring each of the basis's variables in, in place of a restricted
+    // basic variable that is not in it.  ( An unrestricted one made
+    // parametric would be stuck at zero, neither simplex moving it.)
+    for ( it_var = basicVars.begin(); it_var != basicVars.end(); ++it_var)
+      {
+      const Variable & entryVar = *it_var;
+      if ( FIsBasicVar( entryVar))
+        continue;
+      Variable exitVar = clvNil;
+      Number best = _epsilon;
+      const VarSet & column = ConstColumn( entryVar);
+      VarSet::const_iterator it_row = column.begin();
+      for ( ; it_row != column.end(); ++it_row)
+        {
+        const Variable & basicVar = *it_row;
+        if ( basicVar == _objective || !basicVar.IsRestricted() ||
+             target.find( basicVar) != target.end())
+          continue;
+        Number c = fabs( ConstRowExpression( basicVar)->CoefficientFor( entryVar));
+        if ( c > best)
+          {
+          exitVar = basicVar;
+          best = c;
+          }
+        }
+      if ( exitVar.IsNil())
+        break;
+      Pivot( entryVar, exitVar);
+      }
+
+    // The constants are the current ones, so some rows may have gone
+    // negative.  If the basis is optimal for this objective, the dual
+    // simplex can mend them; if not ( it was only partly restored, or
+    // belonged to other constraints), it is no use.
+    bool fDualFeasible = true;
+    P_LinearExpression pzRow = RowExpression( _objective);
+    const VarToNumberMap & terms = pzRow->Terms();
+    VarToNumberMap::const_iterator it_term = terms.begin();
+    for ( ; it_term != terms.end(); ++it_term)
       {
-      ostringstream ss;
-      ss << "objective function is unbounded!" << ends;
-      throw ExCLInternalError( ss.str() );
+      if ( (*it_term).first.IsPivotable() && (*it_term).second < -_epsilon)
+        fDualFeasible = false;
       }
-    Pivot( entryVar, exitVar);
-#ifdef CL_TRACE
-    cout << "After Optimize:\n"
-         << *this << endl;
-#endif
+    TableauRowsMap::const_iterator it_row = _rows.begin();
+    for ( ; it_row != _rows.end(); ++it_row)
+      {
+      if ( (*it_row).first.IsRestricted() && (*it_row).second->Constant() < 0.0)
+        _infeasibleRows.insert( (*it_row).first);
+      }
+    if (!_infeasibleRows.empty() && !fDualFeasible)
+      {
+      RollbackJournal( cEntries);
+      _bases.pop_front();
+      return false;
+      }
+    DualOptimize();
+    }
+  catch ( ExCLError & )
+    {
+    RollbackJournal( cEntries);
+    _bases.pop_front();
+    return false;
+    }
+  catch ( ... )
+    {
+    RollbackJournal( cEntries);
+    throw;
     }
+  CommitJournal();
+  return true;
 }
 
 // Do a Pivot.  Move entryVar into the basis ( i.e. make it a basic variable),
@@ -1473,6 +4620,7 @@ SimplexSolver::Pivot( const Variable & entryVar, const Variable & exitVar)
   // expr is the Expression for the exit variable ( about to leave the basis) -- 
   // so that the old tableau includes the equation:
   //   exitVar = expr
+  NotePivot();
   P_LinearExpression pexpr = RemoveRow( exitVar);
 
   // Compute an Expression for the entry variable.  Since expr has
@@ -1485,6 +4633,7 @@ SimplexSolver::Pivot( const Variable & entryVar, const Variable & exitVar)
     {
     // entry var is no longer a parametric variable since we're moving
     // it into the basis
+    JournalMember( _externalParametricVars, entryVar, false);
     _externalParametricVars.erase( entryVar);
     }
   addRow( entryVar,pexpr);
@@ -1512,6 +4661,7 @@ SimplexSolver::ResetStayConstants()
   Tracer TRACER( __FUNCTION__);
   cout << "()" << endl;
 #endif
+  CatchUpTableau();
   VarVector::const_iterator 
     itStayPlusErrorVars = _stayPlusErrorVars.begin();
   VarVector::const_iterator 
@@ -1525,9 +4675,12 @@ SimplexSolver::ResetStayConstants()
       {
       pexpr = RowExpression(*itStayMinusErrorVars);
       }
-    if ( pexpr != NULL)
+    if ( pexpr != NULL && pexpr->Constant() != 0.0)
       {
+      JournalTerms( pexpr, clvNil);
       pexpr->Set_constant( 0.0);
+      // the stay moved, so the cached regions no longer hold
+      ClearRegionCache();
       }
     }
 }
@@ -1553,6 +4706,9 @@ SimplexSolver::SetExternalVariables()
 
   // FIXGJB -- oughta check some invariants here
 
+  ++_cSolutions;
+  _changedVars.clear();
+  _snappedValues.clear();
   // Set external parametric variables first
   // in case I've screwed up
   VarSet::iterator itParVars = _externalParametricVars.begin();
@@ -1582,11 +4738,91 @@ SimplexSolver::SetExternalVariables()
   for ( ; itRowVars != _externalRows.end() ; ++itRowVars )
     {
     const Variable & v = *itRowVars;
-    P_LinearExpression pexpr = RowExpression( v);
+    P_LinearExpression pexpr = ConstRowExpression( v);
     Changev( v,pexpr->Constant());
     }
 
   _fNeedsSolving = false;
+  _fExternalValuesInSync = true;
+  _editedExternalRows.clear();
+  if ( _fTracksSatisfaction)
+    UpdateSatisfaction();
+  if ( _pfnChangesCallback && !_changedVars.empty())
+    _pfnChangesCallback( this, _changedVars);
+  if ( _pfnResolveCallback)
+    _pfnResolveCallback( this);
+}
+
+SimplexSolver &
+SimplexSolver::SetWritesVariables( bool f)
+{
+  if ( f == _fWritesVariables)
+    return *this;
+  // ValueOf() reads the tableau, so it may not be left behind
+  CatchUpTableau();
+  _fWritesVariables = f;
+  if ( f && !_fNeedsSolving)
+    SetExternalVariables();
+  return *this;
+}
+
+void
+SimplexSolver::UpdateValues( const vector<Variable> & vars)
+{
+#ifdef CL_TRACE
+  Tracer TRACER( __FUNCTION__);
+#endif
+  CatchUpTableau();
+  vector<Variable>::const_iterator it = vars.begin();
+  for ( ; it != vars.end(); ++it)
+    WriteValue( *it, ValueOf( *it));
+}
+
+void
+SimplexSolver::WriteValue( Variable clv, Number n)
+{
+  if ( _pjournal)
+    JournalValue( clv);
+  clv.ChangeValue( n); 
+  if ( _pfnChangevCallback) 
+    _pfnChangevCallback( &clv, this);
+}
+
+// Compare with the value last reported, not the last one written, so
+// that moves within the tolerance add up
+void
+SimplexSolver::NoteNewValue( const Variable & v, Number n)
+{
+  VarToNumberMap::iterator it = _reportedValues.find( v);
+  if ( it == _reportedValues.end())
+    it = _reportedValues.insert( VarToNumberMap::value_type( v, v.Value())).first;
+  if ( fabs( n - (*it).second) > _changeTolerance)
+    {
+    _changedVars.push_back( v);
+    (*it).second = n;
+    }
+}
+
+void
+SimplexSolver::SetEditedExternalVariables()
+{
+#ifdef CL_TRACE
+  Tracer TRACER( __FUNCTION__);
+#endif
+  ++_cSolutions;
+  _changedVars.clear();
+  _snappedValues.clear();
+  VarSet::const_iterator it = _editedExternalRows.begin();
+  for ( ; it != _editedExternalRows.end(); ++it)
+    {
+    const Variable & v = *it;
+    Changev( v,ConstRowExpression( v)->Constant());
+    }
+  _editedExternalRows.clear();
+  if ( _fTracksSatisfaction)
+    UpdateSatisfaction();
+  if ( _pfnChangesCallback && !_changedVars.empty())
+    _pfnChangesCallback( this, _changedVars);
   if ( _pfnResolveCallback)
     _pfnResolveCallback( this);
 }
@@ -1656,6 +4892,337 @@ SimplexSolver::PrintInternalInfo( ostream & xo) const
   return xo;
 }
 
+
+// Sets the precision of xo so doubles are written exactly, and puts it
+// back as it was when it goes out of scope
+class ExactNumbers {
+ public:
+  ExactNumbers( ostream & xo)
+      : _xo( xo), _flags( xo.flags()), _precision( xo.precision())
+    { _xo.unsetf( ios::floatfield); _xo.precision( 17); }
+  ~ExactNumbers()
+    { _xo.flags( _flags); _xo.precision( _precision); }
+
+ private:
+  ostream & _xo;
+  ios::fmtflags _flags;
+  streamsize _precision;
+};
+
+// The linear program for WriteLP() and WriteMPS().  The columns are
+// the variables the constraints use, in the order they are first used,
+// and the constraints' error variables.  All the rows are equations or
+// >= inequalities.
+class ModelExport {
+ public:
+  class Row {
+   public:
+    string _name;
+    // by column
+    vector<pair<size_t, Number> > _terms;
+    bool _fInequality;
+    Number _rhs;
+  };
+
+  // The column for v, added if it is new
+  size_t Column( const Variable & v)
+    {
+    map<const AbstractVariable *, size_t>::iterator it = _columns.find( v.get_pclv());
+    if ( it != _columns.end())
+      return (*it).second;
+    size_t i = NewColumn( v.Name(), true);
+    _columns[v.get_pclv()] = i;
+    return i;
+    }
+
+  // Add a column named name ( or as close to it as the formats allow),
+  // free or >= 0, with no cost
+  size_t NewColumn( const string & name, bool fFree)
+    {
+    _columnNames.push_back( UniqueName( name, _columnNamesUsed));
+    _fFreeColumns.push_back( fFree);
+    _objective.push_back( 0.0);
+    return _columnNames.size() - 1;
+    }
+
+  Row & NewRow( const string & name)
+    {
+    _rows.push_back( Row());
+    _rows.back()._name = UniqueName( name, _rowNamesUsed);
+    return _rows.back();
+    }
+
+  vector<string> _columnNames;
+  vector<bool> _fFreeColumns;
+  // the cost of each column
+  vector<Number> _objective;
+  vector<Row> _rows;
+
+ private:
+  // name with the characters neither format has trouble with, not
+  // starting like a number, and not in used ( which it is then added
+  // to)
+  static string UniqueName( const string & name, set<string> & used)
+    {
+    string base;
+    for ( size_t i = 0; i < name.size(); ++i)
+      {
+      char ch = name[i];
+      base += ( isalnum( (unsigned char) ch) || ch == '_' || ch == '.')? ch : '_';
+      }
+    if ( base.empty() || !isalpha( (unsigned char) base[0]) ||
+         base[0] == 'e' || base[0] == 'E')
+      base = "x_" + base;
+    string unique = base;
+    for ( int n = 2; used.find( unique) != used.end(); ++n)
+      {
+      ostringstream xo;
+      xo << base << "_" << n;
+      unique = xo.str();
+      }
+    used.insert( unique);
+    return unique;
+    }
+
+  map<const AbstractVariable *, size_t> _columns;
+  set<string> _columnNamesUsed;
+  set<string> _rowNamesUsed;
+};
+
+void
+SimplexSolver::ExportModel( ModelExport & model) const
+{
+  int iRow = 0;
+  ConstraintToVarMap::const_iterator it = _markerVars.begin();
+  for ( ; it != _markerVars.end(); ++it)
+    {
+    P_Constraint pcn = (*it).first;
+    LinearExpression expr = pcn->Expression();
+    if ( pcn->IsEditConstraint() || pcn->isStayConstraint())
+      {
+      // value - v, with the value the edit last suggested ( or the
+      // variable's current value); write it as v = value
+      EditOrStayConstraint * pcnEoS = dynamic_cast<EditOrStayConstraint * >( pcn.ptr());
+      Number value = SolvedValue( pcnEoS->variable());
+      if ( pcn->IsEditConstraint())
+        {
+        EditInfoList::const_iterator it_edit = _editInfoList.begin();
+        for ( ; it_edit != _editInfoList.end(); ++it_edit)
+          if ( (*it_edit)->_pconstraint == pcn)
+            value = (*it_edit)->_prevEditConstant;
+        }
+      expr = expr.Times( -1.0);
+      expr.Set_constant( -value);
+      }
+
+    ostringstream xoName;
+    xoName << "c" << ++iRow;
+    ModelExport::Row & row = model.NewRow( xoName.str());
+    row._fInequality = pcn->IsInequality();
+    row._rhs = ( expr.Constant() == 0.0)? 0.0 : -expr.Constant();
+    VarToNumberMap::const_iterator it_term = expr.Terms().begin();
+    for ( ; it_term != expr.Terms().end(); ++it_term)
+      row._terms.push_back( make_pair( model.Column( (*it_term).first), (*it_term).second));
+    sort( row._terms.begin(), row._terms.end());
+
+    if ( !pcn->IsRequired())
+      {
+      // expr + eminus [ - eplus] ( >)= 0, minimizing the errors
+      Number cost = ErrorWeight( pcn);
+      size_t iMinus = model.NewColumn( row._name + "_em", false);
+      row._terms.push_back( make_pair( iMinus, 1.0));
+      model._objective[iMinus] = cost;
+      if ( !row._fInequality)
+        {
+        size_t iPlus = model.NewColumn( row._name + "_ep", false);
+        row._terms.push_back( make_pair( iPlus, -1.0));
+        model._objective[iPlus] = cost;
+        }
+      }
+    }
+}
+
+// Write the terms, as LP does
+static void
+WriteLPTerms( ostream & xo, const vector<pair<size_t, Number> > & terms,
+              const vector<string> & names)
+{
+  bool fFirst = true;
+  for ( size_t i = 0; i < terms.size(); ++i)
+    {
+    Number coeff = terms[i].second;
+    if ( coeff == 0.0)
+      continue;
+    if ( coeff < 0)
+      xo << ( fFirst? " -" : " - ");
+    else if ( !fFirst)
+      xo << " + ";
+    else
+      xo << " ";
+    if ( fabs( coeff) != 1.0)
+      xo << fabs( coeff) << " ";
+    xo << names[terms[i].first];
+    fFirst = false;
+    // the format limits the length of lines
+    if ( i % 8 == 7)
+      xo << "\n  ";
+    }
+  if ( fFirst)
+    xo << " 0 " << ( names.empty()? string( "x") : names[0]);
+}
+
+ostream &
+SimplexSolver::WriteLP( ostream & xo) const
+{
+  ModelExport model;
+  ExportModel( model);
+  ExactNumbers exact( xo);
+
+  xo << "\\ Cassowary model: " << model._rows.size() << " constraints, "
+     << model._columnNames.size() << " variables\n";
+  xo << "Minimize\n obj:";
+  vector<pair<size_t, Number> > objective;
+  for ( size_t i = 0; i < model._objective.size(); ++i)
+    if ( model._objective[i] != 0.0)
+      objective.push_back( make_pair( i, model._objective[i]));
+  WriteLPTerms( xo, objective, model._columnNames);
+  xo << "\nSubject To\n";
+  for ( size_t i = 0; i < model._rows.size(); ++i)
+    {
+    const ModelExport::Row & row = model._rows[i];
+    xo << " " << row._name << ":";
+    WriteLPTerms( xo, row._terms, model._columnNames);
+    xo << ( row._fInequality? " >= " : " = ") << row._rhs << "\n";
+    }
+  xo << "Bounds\n";
+  for ( size_t i = 0; i < model._columnNames.size(); ++i)
+    if ( model._fFreeColumns[i])
+      xo << " " << model._columnNames[i] << " free\n";
+  xo << "End\n";
+  return xo;
+}
+
+ostream &
+SimplexSolver::WriteMPS( ostream & xo) const
+{
+  ModelExport model;
+  ExportModel( model);
+  ExactNumbers exact( xo);
+
+  // the rows of each column
+  vector<vector<pair<size_t, Number> > > columns( model._columnNames.size());
+  for ( size_t i = 0; i < model._rows.size(); ++i)
+    {
+    const vector<pair<size_t, Number> > & terms = model._rows[i]._terms;
+    for ( size_t j = 0; j < terms.size(); ++j)
+      columns[terms[j].first].push_back( make_pair( i, terms[j].second));
+    }
+
+  xo << "* Cassowary model: " << model._rows.size() << " constraints, "
+     << model._columnNames.size() << " variables\n";
+  xo << "NAME cassowary\nROWS\n N obj\n";
+  for ( size_t i = 0; i < model._rows.size(); ++i)
+    xo << ( model._rows[i]._fInequality? " G " : " E ") << model._rows[i]._name << "\n";
+  xo << "COLUMNS\n";
+  for ( size_t j = 0; j < columns.size(); ++j)
+    {
+    const string & name = model._columnNames[j];
+    if ( model._objective[j] != 0.0)
+      xo << " " << name << " obj " << model._objective[j] << "\n";
+    for ( size_t k = 0; k < columns[j].size(); ++k)
+      if ( columns[j][k].second != 0.0)
+        xo << " " << name << " " << model._rows[columns[j][k].first]._name
+           << " " << columns[j][k].second << "\n";
+    }
+  xo << "RHS\n";
+  for ( size_t i = 0; i < model._rows.size(); ++i)
+    if ( model._rows[i]._rhs != 0.0)
+      xo << " rhs " << model._rows[i]._name << " " << model._rows[i]._rhs << "\n";
+  xo << "BOUNDS\n";
+  for ( size_t j = 0; j < columns.size(); ++j)
+    if ( model._fFreeColumns[j])
+      xo << " FR bnd " << model._columnNames[j] << "\n";
+  xo << "ENDATA\n";
+  return xo;
+}
+
+static const char *
+SzVariableKind( const Variable & v)
+{
+  if ( v.IsFDVariable())
+    return "fd";
+  else if ( v.IsFloatVariable())
+    return "float";
+  else if ( v.IsDummy())
+    return "dummy";
+  else if ( v.IsRestricted())
+    return "slack";
+  else
+    return "objective";
+}
+
+ostream &
+SimplexSolver::WriteTableau( ostream & xo) const
+{
+  // the objective row first, then the others
+  vector<Variable> rows;
+  rows.push_back( _objective);
+  TableauRowsMap::const_iterator it_row = _rows.begin();
+  for ( ; it_row != _rows.end(); ++it_row)
+    if ( !( (*it_row).first == _objective))
+      rows.push_back( (*it_row).first);
+
+  // the parametric variables, in the order they are first used
+  vector<Variable> columns;
+  map<const AbstractVariable *, size_t> columnIndexes;
+  size_t cEntries = 0;
+  for ( size_t i = 0; i < rows.size(); ++i)
+    {
+    P_LinearExpression pexpr = RowExpression( rows[i]);
+    const VarToNumberMap & terms = pexpr->Terms();
+    for ( VarToNumberMap::const_iterator it = terms.begin(); it != terms.end(); ++it)
+      {
+      if ( columnIndexes.find( (*it).first.get_pclv()) == columnIndexes.end())
+        {
+        columnIndexes[(*it).first.get_pclv()] = columns.size();
+        columns.push_back( (*it).first);
+        }
+      ++cEntries;
+      }
+    if ( pexpr->Constant() != 0.0)
+      ++cEntries;
+    }
+
+  ExactNumbers exact( xo);
+  xo << "%%MatrixMarket matrix coordinate real general\n"
+     << "% Cassowary tableau: each row's basic variable is its constant,\n"
+     << "% in the last column, plus its coefficients times the\n"
+     << "% parametric variables\n";
+  for ( size_t i = 0; i < rows.size(); ++i)
+    xo << "% row " << i + 1 << ": " << rows[i].Name()
+       << " ( " << SzVariableKind( rows[i]) << ")\n";
+  for ( size_t j = 0; j < columns.size(); ++j)
+    xo << "% column " << j + 1 << ": " << columns[j].Name()
+       << " ( " << SzVariableKind( columns[j]) << ")\n";
+  xo << "% column " << columns.size() + 1 << ": constant\n";
+
+  xo << rows.size() << " " << columns.size() + 1 << " " << cEntries << "\n";
+  for ( size_t i = 0; i < rows.size(); ++i)
+    {
+    P_LinearExpression pexpr = RowExpression( rows[i]);
+    vector<pair<size_t, Number> > entries;
+    const VarToNumberMap & terms = pexpr->Terms();
+    for ( VarToNumberMap::const_iterator it = terms.begin(); it != terms.end(); ++it)
+      entries.push_back( make_pair( columnIndexes[(*it).first.get_pclv()], (*it).second));
+    sort( entries.begin(), entries.end());
+    for ( size_t k = 0; k < entries.size(); ++k)
+      xo << i + 1 << " " << entries[k].first + 1 << " " << entries[k].second << "\n";
+    if ( pexpr->Constant() != 0.0)
+      xo << i + 1 << " " << columns.size() + 1 << " " << pexpr->Constant() << "\n";
+    }
+  return xo;
+}
+
 ostream & operator<<( ostream & xo, const SimplexSolver & clss)
 {
   return clss.PrintOn( xo);
@@ -1671,36 +5238,211 @@ SimplexSolver::FIsConstraintSatisfied( P_Constraint pcn) const
     { // could not find the constraint
     throw ExCLConstraintNotFound( pcn);
     }
+  const_cast<SimplexSolver * >( this)->CatchUpTableau();
 
-#ifndef CL_NO_IO
-  bool fCnsays = pcn->FIsSatisfied();
+  bool fSatisfied = FErrorVarsZero( pcn);
+#ifdef CL_TRACE
+  if ( fSatisfied != pcn->FIsSatisfied())
+    cout << __FUNCTION__ << ": the solver and the constraint disagree" << endl;
 #endif
+  return fSatisfied;
+}
+
+void
+SimplexSolver::ConstraintErrors( const vector<P_Constraint> & cns, Number * errors,
+                                 bool fWeighted)
+{
+  // ( evaluating the expressions costs less than looking up the error
+  // variables' rows)
+  if (!_fWritesVariables)
+    CatchUpTableau();
+  for ( size_t i = 0; i < cns.size(); ++i)
+    {
+    P_Constraint pcn = cns[i];
+    // ( only an edit or stay has to make its expression)
+    const LinearConstraint * plcn = dynamic_cast<const LinearConstraint * >( pcn.ptr());
+    LinearExpression exprCopy;
+    if (!plcn)
+      {
+      exprCopy = pcn->Expression();
+      if ( pcn->IsEditConstraint() || pcn->isStayConstraint())
+        {
+        EditOrStayConstraint * pcnEoS = dynamic_cast<EditOrStayConstraint * >( pcn.ptr());
+        exprCopy.Set_constant( SolvedValue( pcnEoS->variable()));
+        }
+      }
+    const LinearExpression & expr = plcn? plcn->ConstExpression() : exprCopy;
+    Number value = expr.Constant();
+    VarToNumberMap::const_iterator it = expr.Terms().begin();
+    for ( ; it != expr.Terms().end(); ++it)
+      {
+      const Variable & v = (*it).first;
+      value += (*it).second * SolvedValue( v);
+      }
+    Number error;
+    if ( pcn->IsInequality())
+      error = ( value < 0.0)? -value : 0.0;
+    else
+      error = fabs( value);
+    if ( fWeighted)
+      error *= pcn->strength().symbolicWeight().AsDouble() * pcn->weight();
+    errors[i] = error;
+    }
+}
 
+bool
+SimplexSolver::FErrorVarsZero( P_Constraint pcn) const
+{
   ConstraintToVarSetMap::const_iterator it_eVars = _errorVars.find( pcn);
+  if ( it_eVars == _errorVars.end())
+    return true;
+  const VarSet & eVars = (*it_eVars).second;
+  VarSet::const_iterator it = eVars.begin();
+  for ( ; it != eVars.end(); ++it )
+    {
+    P_LinearExpression pexpr = ConstRowExpression(*it);
+    if ( pexpr != NULL && !Approx( pexpr->Constant(),0.0))
+      return false;
+    }
+  return true;
+}
 
-  if ( it_eVars != _errorVars.end())
+SimplexSolver &
+SimplexSolver::SetTracksSatisfaction( bool f)
+{
+  CheckNoTransaction("SetTracksSatisfaction");
+  if ( f == _fTracksSatisfaction)
+    return *this;
+  _fTracksSatisfaction = f;
+  _errorVarOwners.clear();
+  _unsatisfiedCns.clear();
+  _touchedRows.clear();
+  _satChanges.clear();
+  _ptouchedRows = f? &_touchedRows : NULL;
+  if (!f)
+    return *this;
+  CatchUpTableau();
+  ClearRegionCache();
+  // start from the constraints as they are, without reporting them
+  ConstraintToVarSetMap::const_iterator it_eVars = _errorVars.begin();
+  for ( ; it_eVars != _errorVars.end(); ++it_eVars)
     {
+    P_Constraint pcn = (*it_eVars).first;
+    if ( pcn->IsEditConstraint() || pcn->isStayConstraint())
+      continue;
     const VarSet & eVars = (*it_eVars).second;
     VarSet::const_iterator it = eVars.begin();
-    for ( ; it != eVars.end(); ++it )
-      {
-      P_LinearExpression pexpr = RowExpression(*it);
-      if ( pexpr != NULL && !Approx( pexpr->Constant(),0.0))
-        {
-#ifndef CL_NO_IO
-        if ( fCnsays)
-          cout << __FUNCTION__ << ": constraint says satisfiable, but solver does not" << endl;
+    for ( ; it != eVars.end(); ++it)
+      _errorVarOwners[*it] = pcn;
+    if (!FErrorVarsZero( pcn))
+      _unsatisfiedCns.insert( pcn);
+    }
+  return *this;
+}
+
+void
+SimplexSolver::NoteErrorVarsAdded( P_Constraint pcn)
+{
+  if (!_fTracksSatisfaction || pcn->IsEditConstraint() || pcn->isStayConstraint())
+    return;
+  const VarSet & eVars = _errorVars[pcn];
+  VarSet::const_iterator it = eVars.begin();
+  for ( ; it != eVars.end(); ++it)
+    {
+    JournalEntry( _errorVarOwners, *it);
+    _errorVarOwners[*it] = pcn;
+    _touchedRows.push_back( *it);
+    }
+}
+
+void
+SimplexSolver::NoteErrorWeight( P_Constraint pcn, Number weight)
+{
+  if ( pcn->IsEditConstraint())
+    return;
+  JournalEntry( _errorWeights, pcn);
+  _errorWeights[pcn] = weight;
+}
+
+void
+SimplexSolver::NoteErrorVarsRemoved( P_Constraint pcn)
+{
+  if (!_fTracksSatisfaction || pcn->IsEditConstraint() || pcn->isStayConstraint())
+    return;
+  const VarSet & eVars = _errorVars[pcn];
+  VarSet::const_iterator it = eVars.begin();
+  for ( ; it != eVars.end(); ++it)
+    {
+    JournalEntry( _errorVarOwners, *it);
+    _errorVarOwners.erase( *it);
+    }
+  if ( _unsatisfiedCns.find( pcn) != _unsatisfiedCns.end())
+    {
+    if ( _pjournal)
+      _pjournal->SaveMember( _unsatisfiedCns, pcn);
+    _unsatisfiedCns.erase( pcn);
+    }
+}
+
+void
+SimplexSolver::UpdateSatisfaction()
+{
+#ifdef CL_TRACE
+  Tracer TRACER( __FUNCTION__);
 #endif
-        return false;
-        }
+  _satChanges.clear();
+  // ( a row may be noted more than once, or no longer be a tracked
+  // error variable's; checking it again changes nothing)
+  for ( size_t i = 0; i < _touchedRows.size(); ++i)
+    {
+    VarToConstraintMap::const_iterator it_owner = _errorVarOwners.find( _touchedRows[i]);
+    if ( it_owner == _errorVarOwners.end())
+      continue;
+    P_Constraint pcn = (*it_owner).second;
+    bool fSatisfied = FErrorVarsZero( pcn);
+    if ( fSatisfied == ( _unsatisfiedCns.find( pcn) != _unsatisfiedCns.end()))
+      {
+      if ( _pjournal)
+        _pjournal->SaveMember( _unsatisfiedCns, pcn);
+      if ( fSatisfied)
+        _unsatisfiedCns.erase( pcn);
+      else
+        _unsatisfiedCns.insert( pcn);
+      NoteSatisfaction( pcn, fSatisfied);
       }
     }
+  _touchedRows.clear();
+}
 
-#ifndef CL_NO_IO
-  if (!fCnsays)
-    cout << __FUNCTION__ << ": solver says satisfiable, but constraint does not" << endl;
-#endif
-  return true;
+void
+SimplexSolver::NoteSatisfaction( P_Constraint pcn, bool fSatisfied)
+{
+  _satChanges.push_back( make_pair( pcn, fSatisfied));
+  if ( _pjournal)
+    _satChangesLogged.push_back( make_pair( pcn, fSatisfied));
+  if ( _pfnCnSatCallback)
+    _pfnCnSatCallback( this, pcn, fSatisfied);
+}
+
+void
+SimplexSolver::ReportRolledBackSatisfaction()
+{
+  // what was last reported for each constraint, against what the
+  // rollback put back ( a constraint it removed counts as satisfied)
+  map<P_Constraint, bool> reported;
+  SatChangeList::const_iterator it = _satChangesLogged.begin();
+  for ( ; it != _satChangesLogged.end(); ++it)
+    reported[(*it).first] = (*it).second;
+  if ( _transactionMarks.empty())
+    _satChangesLogged.clear();
+  map<P_Constraint, bool>::const_iterator it_reported = reported.begin();
+  for ( ; it_reported != reported.end(); ++it_reported)
+    {
+    P_Constraint pcn = (*it_reported).first;
+    bool fSatisfied = ( _unsatisfiedCns.find( pcn) == _unsatisfiedCns.end());
+    if ( fSatisfied != (*it_reported).second)
+      NoteSatisfaction( pcn, fSatisfied);
+    }
 }
 
 
@@ -1725,17 +5467,42 @@ ostream & operator<<( ostream & xo, const SimplexSolver::EditInfoList & listPEdi
 // A. Beurive' Tue Jul  6 17:03:32 CEST 1999
 void
 SimplexSolver::ChangeStrengthAndWeight( P_Constraint pcn, const Strength & strength, double weight)
+{
+  CheckNoTransaction("ChangeStrengthAndWeight");
+  bool fChanged = SetErrorWeight( pcn, weight * strength.symbolicWeight().AsDouble());
+  pcn->setStrength( strength);
+  pcn->setWeight( weight);
+  if ( fChanged && _fAutosolve)
+    {
+    Optimize( _objective);
+    SetExternalVariables();
+    }
+}
+
+bool
+SimplexSolver::SetErrorWeight( P_Constraint pcn, Number new_coeff)
 {
   ConstraintToVarSetMap::iterator it_eVars = _errorVars.find( pcn);
   // Only for constraints that already have error variables ( i.e. non-required constraints)
   assert( it_eVars != _errorVars.end());
+  CatchUpTableau();
 
   P_LinearExpression pzRow = RowExpression( _objective);
 
-  Number old_coeff = pcn->weight() * pcn->strength().symbolicWeight().AsDouble();
-  pcn->setStrength( strength);
-  pcn->setWeight( weight);
-  Number new_coeff = pcn->weight() * pcn->strength().symbolicWeight().AsDouble();
+  Number old_coeff = ErrorWeight( pcn);
+  const Variable & marker = _markerVars[pcn];
+  _activeFingerprint -= FingerprintTerm( marker, old_coeff);
+  _activeFingerprint += FingerprintTerm( marker, new_coeff);
+  if ( pcn->IsEditConstraint())
+    {
+    const Variable & v = dynamic_cast<EditConstraint * >( pcn.ptr())->variable();
+    P_EditInfo pcei = PEditInfoFromv( v);
+    if (!pcei || pcei->_pconstraint != pcn)
+      pcei = _editSlots[v];
+    pcei->_errorWeight = new_coeff;
+    }
+  else
+    NoteErrorWeight( pcn, new_coeff);
 
   if ( new_coeff != old_coeff)
     {
@@ -1762,12 +5529,45 @@ SimplexSolver::ChangeStrengthAndWeight( P_Constraint pcn, const Strength & stren
 #ifdef CL_TRACE
       cout << "to: " << endl << * pzRow << endl;
 #endif
+      ClearRegionCache();
+      return true;
+    }
+  return false;
+}
 
-      if ( _fAutosolve)
-        {
-          Optimize( _objective);
-          SetExternalVariables();
-        }
+// Bring a parked edit slot into use.  First move its edit constant to
+// v's current value, which brings its error variables to 0.  Raising
+// their weight then leaves the current solution optimal, but the
+// basis may not be ( which DualOptimize relies on), so Optimize; this
+// only makes degenerate pivots, and the values stay as they are.
+// ( Only this solver's weight for the slot changes; its constraint
+// keeps the strength it was made with.)
+void
+SimplexSolver::ActivateEditSlot( P_EditInfo pcei, const Strength & strength, double weight)
+{
+  CatchUpTableau();
+  Number value = SolvedValue( pcei->_clv);
+  DeltaEditConstant( value - pcei->_prevEditConstant,
+                     pcei->_clvEditPlus, pcei->_clvEditMinus);
+  pcei->_prevEditConstant = value;
+  if ( SetErrorWeight( pcei->_pconstraint, weight * strength.symbolicWeight().AsDouble()))
+    Optimize( _objective);
+  NoteEditInUse( pcei);
+}
+
+// Park an edit slot that is in use: as removing its edit constraint
+// would, but with just a drop of its weight to 0
+void
+SimplexSolver::ParkEditSlot( P_EditInfo pcei)
+{
+  _fNeedsSolving = true;
+  ResetStayConstants();
+  SetErrorWeight( pcei->_pconstraint, 0.0);
+  NoteEditDone( pcei);
+  if ( _fAutosolve)
+    {
+    Optimize( _objective);
+    SetExternalVariables();
     }
 }
 
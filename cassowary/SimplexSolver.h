@@ -29,6 +29,9 @@
 class Variable;
 class Point;
 class ExCLRequiredFailureWithExplanation;
+class SolverSaver;
+class SolverLoader;
+class ModelExport;
 
 
 // SimplexSolver encapsulates the solving behaviour
@@ -38,15 +41,126 @@ public:
   class EditInfo;
   typedef RefCountPtr< EditInfo> P_EditInfo;
   typedef list<P_EditInfo > EditInfoList;
+  typedef Map<Variable, P_EditInfo> VarToEditInfoMap;
+  typedef Map<P_Constraint, Number> ConstraintToNumberMap;
+
+  // Names an edit variable's edit for SuggestValues; valid until the
+  // edit is removed ( or its edit slot parked)
+  typedef P_EditInfo EditHandle;
+
+  // What NewExpression() built for a grouped constraint: the
+  // constraint's own expression, and the marker and negative error
+  // variables it made.  These are kept while the group is inactive, so
+  // re-activating it does not rebuild them.
+  class PreparedConstraint {
+  public:
+    PreparedConstraint( const string & group, const LinearExpression & expr)
+        : _group( group), _expression( expr),
+          _clvMarker( clvNil), _clvEminus( clvNil), _fRequired( false)
+      { }
+
+    string _group;
+    LinearExpression _expression;
+    Variable _clvMarker;
+    Variable _clvEminus;
+    bool _fRequired;
+  };
+  typedef Map<P_Constraint, PreparedConstraint> PreparedConstraintMap;
+
+  class ConstraintGroup {
+  public:
+    ConstraintGroup() : _fActive( false) { }
+
+    vector<P_Constraint> _constraints;
+    bool _fActive;
+  };
+  typedef Map<string, ConstraintGroup> ConstraintGroupMap;
+
+  // A critical region of the edit space, as kept by the region cache:
+  // the edit values for which the basis it was recorded in is optimal
+  // ( each of the restricted rows, at its constant plus its rates
+  // times the change in the edit values, stays >= 0), with the
+  // external variables' values there as affine functions of the edit
+  // values.  Edits are in _editInfoList order.
+  class CriticalRegion {
+  public:
+    vector<Number> _editValues;
+    // for each restricted row, its constant and then its rate for
+    // each edit
+    vector<Number> _rowBounds;
+    vector<Variable> _vars;
+    // for each of _vars, its value and then its rate for each edit
+    vector<Number> _varLaws;
+  };
+  typedef list<CriticalRegion> CriticalRegionList;
+
+  // One variant of the model for SolveScenarios(): constraints added to
+  // it and values suggested for variables that are being edited
+  class Scenario {
+  public:
+    Scenario & AddConstraint( P_Constraint pcn)
+      { _constraints.push_back( pcn); return *this; }
+    Scenario & SuggestValue( const Variable & v, Number x)
+      { _editVars.push_back( v); _editValues.push_back( x); return *this; }
+
+    vector<P_Constraint> _constraints;
+    vector<Variable> _editVars;
+    vector<Number> _editValues;
+  };
+
+  // An optimal basis kept by the basis cache: the variables that were
+  // basic ( other than the objective) when the active constraints had
+  // the given fingerprint
+  class CachedBasis {
+  public:
+    size_t _fingerprint;
+    VarVector _basicVars;
+  };
+  typedef list<CachedBasis> CachedBasisList;
 
  protected: 
   typedef Tableau super;
   P_EditInfo PEditInfoFromv( const Variable & );
 
+  // Make this solver's state, apart from the callbacks, that of solver
+  // ( see Clone())
+  void CopyStateFrom( const SimplexSolver & solver);
+
+  // Write this solver's state, or read it into this fresh solver ( see
+  // Save() and Load())
+  void SaveState( SolverSaver & saver) const;
+  void LoadState( SolverLoader & loader);
+
+#ifndef CL_NO_IO
+  // Build the linear program that WriteLP() and WriteMPS() write
+  void ExportModel( ModelExport & model) const;
+#endif
+
+  // Solve scenarios[i] for the next i not yet taken ( counting *pnext
+  // up) until there are none left, starting each from snapshot, and
+  // return how many were solved.  A copy of this solver runs this in
+  // each of SolveScenarios()'s threads.
+  size_t SolveScenariosFrom( const SimplexSolver & snapshot,
+                             const vector<Scenario> & scenarios,
+                             const vector<Variable> & vars,
+                             Number * values, long * pnext);
+
+  // The body of each of SolveScenarios()'s threads
+  static void * RunScenarioJob( void * pv);
+
+  // Add the full edit entry pcei to _editInfoList and the index, or
+  // take it out of both
+  void NoteEditInUse( P_EditInfo pcei);
+  void NoteEditDone( P_EditInfo pcei);
+
  public:
 
   // Constructor
   SimplexSolver();
+
+  // Copy constructor: see Clone()
+  SimplexSolver( const SimplexSolver & solver);
+
   virtual ~SimplexSolver();
   
   // Add constraints so that lower<=var<=upper.  ( nil means no  bound.)
@@ -58,18 +172,64 @@ public:
   // Add the constraint cn to the tableau
   SimplexSolver & AddConstraint( P_Constraint );
 
+  // The Try...() functions do what the functions they are named after
+  // do, but return a ClStatus instead of throwing when they cannot,
+  // leaving the solver as it was.  Nothing is thrown, formatted or
+  // allocated on the way to a failure, so they suit callers that try
+  // many things that may not work.  ( Internal errors still throw.)
+
+  // As AddConstraint.  If cn is a required constraint that cannot be
+  // satisfied and pexplanation is not NULL, the constraints that
+  // conflict with it ( as ExCLRequiredFailureWithExplanation would
+  // give them) are put in *pexplanation, whether or not the solver is
+  // explaining failures.
+  ClStatus TryAddConstraint( P_Constraint pcn, 
+                             ConstraintSet * pexplanation = NULL);
+
+  // As RemoveConstraint
+  ClStatus TryRemoveConstraint( P_Constraint pcn);
+
+  // As SuggestValue
+  ClStatus TrySuggestValue( const Variable & v, Number x);
+
 #ifdef CL_NO_DEPRECATED
   // Deprecated! --02/19/99 gjb
   SimplexSolver & AddConstraint( Constraint & cn) 
     { return AddConstraint(&cn); }
 #endif
 
+  // Add all of cns to the tableau at once, in order.  Constraints are
+  // added directly up to the first one that cannot be; it and all the
+  // ones after it get their artificial variables minimized together in
+  // a single phase 1, and the tableau is optimized only once at the
+  // end.  Required constraints that cannot be satisfied along with the
+  // rest are left out and appended to *pFailed ( if given); when there
+  // are any, phase 1 is undone and those constraints are added one at a
+  // time instead, failing just as AddConstraint would.  Returns the
+  // number of constraints added.  Edit constraints are not accepted
+  // here; use AddEditVar.
+  int AddConstraints( const vector<P_Constraint> & cns, 
+                      vector<P_Constraint> * pFailed = NULL);
+
   // Add an edit constraint for "v" with given strength
   SimplexSolver & AddEditVar( const Variable &, const Strength & strength = sStrong(),
                               double weight = 1.0 );
 
   SimplexSolver & RemoveEditVar( const Variable &);
 
+  // Give v a persistent edit slot: an edit constraint that stays in the
+  // tableau, parked at zero weight, while v is not being edited.
+  // AddEditVar on v then only raises the slot's weight, and removing
+  // the edit var ( e.g., at EndEdit) parks it again, instead of adding
+  // and removing an edit constraint for every edit.
+  SimplexSolver & AddEditSlot( const Variable & v);
+
+  // Take v's edit slot out of the tableau ( ending any edit of v)
+  SimplexSolver & RemoveEditSlot( const Variable & v);
+
+  bool FHasEditSlot( const Variable & v) const
+    { return _editSlots.find( v) != _editSlots.end(); }
+
   // BeginEdit() should be called before sending
   // Resolve() messages, after adding the appropriate edit variables
   SimplexSolver & BeginEdit();
@@ -111,7 +271,14 @@ public:
   // Remove the constraint cn from the tableau
   // Also remove any error variable associated with cn
   SimplexSolver & RemoveConstraint( P_Constraint pcn)
-    { RemoveConstraintInternal( pcn); pcn->removedFrom(*this); return *this; }
+    { RemoveConstraintInternal( pcn); NoteConstraintRemoved( pcn); 
+      if ( _fRemoveUnusedVariablesAutomatically) RemoveUnusedVariableCandidates();
+      return *this; }
+
+  // Remove all of cns from the tableau, resetting the stay constants
+  // and re-optimizing only once.  Throws ExCLConstraintNotFound, before
+  // removing anything, if one of them is not in the tableau.
+  SimplexSolver & RemoveConstraints( const vector<P_Constraint> & cns);
 
 #ifdef CL_NO_DEPRECATED
   // Deprecated! --02/19/99 gjb
@@ -121,6 +288,271 @@ public:
 
   Variable RemoveColumn( const Variable & v)     { return Tableau::RemoveColumn( v); }
 
+  // Retire v from the solver: remove every stay on v, and v's column
+  // along with them ( and v's edit slot, if parked).  Throws
+  // ExCLVariableInUse if v is being edited or if any other constraint
+  // still refers to v.
+  SimplexSolver & RemoveVariable( const Variable & v);
+
+  // Remove the stays ( and so the columns) of all variables that no
+  // constraint other than their stays refers to any more, resetting
+  // the stay constants and re-optimizing only once.  Variables that
+  // are being edited or have edit slots are left alone.
+  SimplexSolver & RemoveUnusedVariables();
+
+  // When set, RemoveConstraint() drops the stays of the variables that
+  // the removed constraint was the last one to refer to, so that the
+  // stays and columns follow the live model rather than its history.
+  // Off by default, since it also removes stays the client added itself.
+  SimplexSolver & SetAutoRemoveUnusedVariables( bool f)
+    { _fRemoveUnusedVariablesAutomatically = f; return *this; }
+
+  bool FIsAutoRemoveUnusedVariables() const
+    { return _fRemoveUnusedVariablesAutomatically; }
+
+  // Return the number of constraints, other than stays and edits,
+  // that refer to v
+  int NumConstraintsUsing( const Variable & v) const
+    { 
+    VarToIntMap::const_iterator it = _varUseCounts.find( v);
+    return ( it != _varUseCounts.end())? (*it).second : 0;
+    }
+
+  // Constraint groups are named sets of constraints, such as the
+  // portrait and landscape rules of a layout, that are added to and
+  // removed from the tableau as a unit.  A group starts out inactive.
+  // A constraint can be in at most one group, and should not be added
+  // or removed directly while it is; its expression is captured when
+  // it joins the group.  Edit and stay constraints cannot be grouped.
+
+  // Put pcn into the named group, creating the group if needed.  If the
+  // group is active pcn is added to the tableau right away.
+  SimplexSolver & AddToGroup( const string & name, P_Constraint pcn);
+
+  // Take pcn out of its group ( and out of the tableau if the group is
+  // active)
+  SimplexSolver & RemoveFromGroup( P_Constraint pcn);
+
+  // Deactivate and forget the named group
+  SimplexSolver & RemoveGroup( const string & name);
+
+  SimplexSolver & ActivateGroup( const string & name)
+    { return SwitchGroups( vector<string>(), vector<string>( 1, name)); }
+
+  SimplexSolver & DeactivateGroup( const string & name)
+    { return SwitchGroups( vector<string>( 1, name), vector<string>()); }
+
+  // Deactivate the groups in namesOff, then activate the ones in
+  // namesOn, re-optimizing only once at the end.  Naming a group that
+  // does not exist throws before anything is switched.  If a required
+  // constraint of an activated group cannot be satisfied, the switch is
+  // undone before the exception propagates.
+  SimplexSolver & SwitchGroups( const vector<string> & namesOff,
+                                const vector<string> & namesOn);
+
+  bool FIsGroupActive( const string & name) const
+    { 
+    ConstraintGroupMap::const_iterator it = _groups.find( name);
+    return ( it != _groups.end() && (*it).second._fActive);
+    }
+
+  // Make the constraints in the tableau, other than edits, stays and
+  // grouped constraints, be exactly those in desired.  Constraints are
+  // matched by structure ( see Constraint::StructuralHash), so a
+  // desired constraint that says the same thing as one already in the
+  // tableau just takes its place.  Only the differences are removed
+  // and added, with one re-optimization at the end.  If a desired
+  // constraint cannot be added, everything is put back as it was
+  // before the exception propagates.
+  SimplexSolver & Reconcile( const vector<P_Constraint> & desired);
+
+  // Start a transaction.  Until it is committed or rolled back, the
+  // solver logs each change to its tableau and bookkeeping ( and to
+  // the variables' values), so that RollbackTransaction() can undo
+  // them exactly, without pivoting or re-solving.  Constraints can be
+  // added, removed and solved for in a transaction; edits, groups,
+  // strength changes and the like throw ExCLTransactionMisuse.
+  // Transactions nest.
+  SimplexSolver & BeginTransaction();
+
+  // Keep the changes made since the matching BeginTransaction()
+  SimplexSolver & CommitTransaction();
+
+  // Undo the changes made since the matching BeginTransaction()
+  SimplexSolver & RollbackTransaction();
+
+  bool FInTransaction() const
+    { return !_transactionMarks.empty(); }
+
+  // The basis cache remembers the optimal bases of up to n sets of
+  // active constraints, by their fingerprint.  When SwitchGroups,
+  // Reconcile, AddConstraints, RemoveConstraints or Solve bring back a
+  // set of constraints seen before, the tableau pivots straight to its
+  // basis ( mending feasibility with the dual simplex, as the stays and
+  // edits may have moved since) instead of optimizing from wherever
+  // the change left it.  0, the default, turns it off.
+  SimplexSolver & SetBasisCacheLimit( size_t n);
+
+  size_t BasisCacheLimit() const
+    { return _cBasisCacheLimit; }
+
+  size_t BasisCacheSize() const
+    { return _bases.size(); }
+
+  void ClearBasisCache()
+    { _bases.clear(); }
+
+  // Changes of the active constraints that did and did not find a
+  // cached basis
+  long BasisCacheHits() const
+    { return _cBasisCacheHits; }
+
+  long BasisCacheMisses() const
+    { return _cBasisCacheMisses; }
+
+  void ResetBasisCacheStats()
+    { _cBasisCacheHits = _cBasisCacheMisses = 0; }
+
+  // A hash of the active constraints ( by marker variable) and their
+  // weights, independent of the order they were added in
+  size_t ActiveFingerprint() const
+    { return _activeFingerprint; }
+
+  // Return a new solver in the same state as this one, for trying
+  // changes out on.  The two share the tableau's row expressions, each
+  // copying a row only when it first changes it, but the columns and
+  // the rest of the bookkeeping are copied and each constraint is told
+  // it is in one more solver, so a clone still takes time in
+  // proportion to the size of the model ( though it does no pivoting).
+  // The clone does not write the variables, which still belong to this
+  // solver ( see SetWritesVariables): read its values with ValueOf(),
+  // or turn writing on to set them from it.  Edit handles belong to
+  // the solver they came from.  Cannot be done in a transaction.
+  SimplexSolver * Clone() const
+    { return new SimplexSolver( *this); }
+
+  // A saved state to Restore() later; the same as a clone that is not
+  // used for anything else
+  SimplexSolver * Snapshot() const
+    { return Clone(); }
+
+  // Put this solver back in the state of snapshot, which is left as it
+  // is ( so can be restored again), and set the variables' values from
+  // it.  The callbacks, and whether this solver writes the variables,
+  // are kept.  Neither solver may be in a transaction.
+  SimplexSolver & Restore( const SimplexSolver & snapshot);
+
+  // Put the whole state of this solver -- its variables, constraints
+  // and strengths, the tableau's rows, the edit and stay bookkeeping,
+  // the groups and the counters -- in bytes, in a compact versioned
+  // binary form that Load() turns back into a solver without pivoting.
+  // The caches are not saved.  The external ( float) variables and the
+  // constraints are numbered in the order they are appended to
+  // *pExternals and *pConstraints ( if given), which is the order
+  // Load() binds them in.
+  void Save( string & bytes, VarVector * pExternals = NULL,
+             vector<P_Constraint> * pConstraints = NULL) const;
+
+  // Save() to the file at path; throws ExCLSolverFileError if it
+  // cannot be written
+  void SaveFile( const char * path, VarVector * pExternals = NULL,
+                 vector<P_Constraint> * pConstraints = NULL) const;
+
+  // Return a new solver in the state saved in the cb bytes at pb.  The
+  // tableau's columns are rebuilt from its rows; nothing is re-solved.
+  // Variables and constraints are made anew, except that the i-th
+  // external variable saved is (*pBindVars)[i] ( and takes its saved
+  // value) and the i-th constraint is (*pBindCns)[i], where those are
+  // given and not nil; a bound constraint has to say the same thing as
+  // the one saved.  The external variables and constraints the solver
+  // ends up with are appended to *pExternals and *pConstraints.
+  // Throws ExCLSolverFileError if the bytes are not a saved solver.
+  static SimplexSolver * Load( const char * pb, size_t cb,
+                               const VarVector * pBindVars = NULL,
+                               const vector<P_Constraint> * pBindCns = NULL,
+                               VarVector * pExternals = NULL,
+                               vector<P_Constraint> * pConstraints = NULL);
+
+  // Load() from the file at path, which is mapped into memory and read
+  // in place where the platform allows
+  static SimplexSolver * LoadFile( const char * path,
+                                   const VarVector * pBindVars = NULL,
+                                   const vector<P_Constraint> * pBindCns = NULL,
+                                   VarVector * pExternals = NULL,
+                                   vector<P_Constraint> * pConstraints = NULL);
+
+  // Solve each of scenarios on a copy of this solver, several at a
+  // time on up to cThreads threads ( 0 means one per processor), and
+  // put the value of each of vars in each scenario in values, a row
+  // per scenario: values[i * vars.size() + j] is vars[j] in
+  // scenarios[i].  The copies keep their values to themselves, so
+  // neither this solver nor the variables are changed.  The edit
+  // variables of the scenarios must be being edited here.  A scenario
+  // whose constraints cannot be added, or that fails in any other way,
+  // gets a row of NaNs; returns the number that did not.  Like Clone(), cannot be done in a
+  // transaction.
+  size_t SolveScenarios( const vector<Scenario> & scenarios,
+                         const vector<Variable> & vars,
+                         Number * values, int cThreads = 0);
+
+  // Whether solving sets the values of the variables, as it does by
+  // default.  With this off the values are left in the tableau, to be
+  // read with ValueOf() or written to just the variables wanted with
+  // UpdateValues(), and the variables' change callback is not called;
+  // a solve then only compares the values with those last reported,
+  // for ChangedVariables().  Turning it back on writes all the values.
+  SimplexSolver & SetWritesVariables( bool f);
+
+  bool FWritesVariables() const
+    { return _fWritesVariables; }
+
+  // Set each of vars to ValueOf() it ( calling the change callback),
+  // whether or not the solver writes the variables
+  void UpdateValues( const vector<Variable> & vars);
+
+  // The number of solutions so far: this goes up whenever solving
+  // gives new values, so values kept from ValueOf() are stale once it
+  // changes
+  unsigned long SolutionNumber() const
+    { return _cSolutions; }
+
+  // The value of v as last solved for ( or snapped to, see
+  // SnapToGrid), whether or not it was written to v ( a variable not in
+  // the tableau just has its own value).  Brings the tableau up to date
+  // first if a region cache hit left it behind.
+  Number ValueOf( const Variable & v) const
+    {
+    if ( !_snappedValues.empty())
+      {
+      VarToNumberMap::const_iterator it = _snappedValues.find( v);
+      if ( it != _snappedValues.end())
+        return (*it).second;
+      }
+    // a region cache hit wrote the variables but left the tableau
+    const_cast<SimplexSolver * >( this)->CatchUpTableau();
+    P_LinearExpression pexpr = RowExpression( v);
+    if ( pexpr)
+      return pexpr->Constant();
+    return ColumnsHasKey( v)? 0.0 : v.Value();
+    }
+
+  // Set vars to multiples of grid ( whole pixels, say), as far as the
+  // required constraints allow, and the other variables to the best
+  // solution given those values.  This is a depth-first branch and
+  // bound over the solved tableau: each of vars in turn is tried at
+  // the multiple nearer its value, then the one on the other side,
+  // then left alone, so as to snap as many of them as possible.  Each
+  // trial is the add of a required equation, in a transaction, and
+  // there are at most cTrialsMax of them; the vars left when they run
+  // out are left alone.  The trials write no variables and call no
+  // callbacks.  Only the values change: the tableau is left as it was,
+  // the snapped values are written to the variables ( if the solver
+  // writes them, with the callbacks, as a solve would) and ValueOf()
+  // gives them until the next solve sets them all afresh.  Returns the
+  // number of vars snapped.
+  int SnapToGrid( const vector<Variable> & vars, Number grid = 1.0,
+                  int cTrialsMax = 256);
+
   // Re-initialize this solver from the original constraints, thus
   // getting rid of any accumulated numerical problems.  ( Actually, we
   // haven't definitely observed any such problems yet)
@@ -157,6 +589,86 @@ public:
   // after Resolve() has been called
   SimplexSolver & SuggestValue( const Variable & v, Number x);
 
+  // For the current basis, the rate at which each external variable
+  // changes with the value suggested for the edit variable v.  Only
+  // the nonzero rates are put in rates.  They hold while the suggested
+  // value stays within EditRange( v).
+  void EditSensitivity( const Variable & v, VarToNumberMap & rates);
+
+  // The interval of values that can be suggested for the edit variable
+  // v, with the other edit values staying put, before the basis has to
+  // change ( the ratio test).  An unbounded side is +/-DBL_MAX.
+  void EditRange( const Variable & v, Number & lower, Number & upper);
+
+  // The region cache remembers, for up to n bases that Resolve() has
+  // reached, the critical region where each is optimal and the
+  // solution there.  A Resolve() whose edit values fall in one of
+  // them then sets the solution from it without pivoting, however far
+  // the tableau has moved since; the tableau itself is only brought
+  // up to date when something else needs it.  Regions hold only for
+  // the current constraints, strengths and edit variables, so any
+  // change to those empties the cache, as does a stay reset that
+  // moves a stay.  0, the default, turns it off.
+  //
+  // The cache needs SetAutoResetStayConstants(false): resetting the
+  // stays after every Resolve() anchors them at the last solution, so
+  // the solution depends on the path the edits took and not just on
+  // the edit values.  Since variables usually carry stays ( see
+  // AddVar), turn the automatic reset off before turning the cache on,
+  // and call ResetStayConstants() where the stays ought to move, such
+  // as at the end of a drag.  The cache also needs the
+  // solver to write the variables and not to track satisfaction.
+  // Throws ExCLTooDifficultSpecial if n > 0 and the solver is not set
+  // up so.
+  SimplexSolver & SetRegionCacheLimit( size_t n);
+
+  // Whether Resolve() can use the region cache, as the solver is set
+  // up now.  Changing the set up after SetRegionCacheLimit() ( or
+  // adding stays with the automatic reset on) leaves the cache inert,
+  // which this reports.
+  bool FIsRegionCacheUsable() const
+    { return _cRegionCacheLimit > 0 && _fWritesVariables && !_fTracksSatisfaction &&
+        (!_fResetStayConstantsAutomatically || _stayPlusErrorVars.empty()); }
+
+  size_t RegionCacheLimit() const
+    { return _cRegionCacheLimit; }
+
+  size_t RegionCacheSize() const
+    { return _regions.size(); }
+
+  void ClearRegionCache()
+    { _regions.clear(); _fRegionRecorded = false; }
+
+  // Resolve()s answered from a cached region, and ones that had to
+  // run the dual simplex with the cache on ( Resolve()s that kept the
+  // basis count as neither)
+  long RegionCacheHits() const
+    { return _cRegionCacheHits; }
+
+  long RegionCacheMisses() const
+    { return _cRegionCacheMisses; }
+
+  void ResetRegionCacheStats()
+    { _cRegionCacheHits = _cRegionCacheMisses = 0; }
+
+  // Return the handle of v's edit, for SuggestValues
+  EditHandle EditHandleFor( const Variable & v);
+
+  // Suggest values[i] for the edit named by handles[i], for each i < n,
+  // then Resolve() once.  Unlike SuggestValue this does no lookups, and
+  // does not depend on the order the edit variables were added in.
+  SimplexSolver & SuggestValues( const EditHandle * handles, 
+                                 const Number * values, size_t n);
+
+  SimplexSolver & SuggestValues( const vector<EditHandle> & handles, 
+                                 const vector<Number> & values)
+    {
+    assert( handles.size() == values.size());
+    if ( handles.empty())
+      { Resolve(); return *this; }
+    return SuggestValues(&handles[0], &values[0], handles.size());
+    }
+
   // Set and check whether or not the solver will attempt to compile
   // an explanation of failure when a required constraint conflicts
   // with another required constraint
@@ -166,6 +678,19 @@ public:
   bool FIsExplaining() const
     { return _fExplainFailure; }
 
+  // Set and check whether explanations of failures are cut down to an
+  // irreducible conflict: the constraint being added and required
+  // constraints in the solver that cannot all hold together, but can
+  // without any one of them.  Finding one takes some trial adds, in a
+  // transaction that is rolled back, on top of the failed add;
+  // otherwise the explanation has every constraint whose marker is in
+  // the row that could not be satisfied, which may be many more.
+  SimplexSolver & SetMinimalExplanations( bool f)
+    { _fMinimalExplanations = f; return *this; }
+
+  bool FIsMinimalExplanations() const
+    { return _fMinimalExplanations; }
+
   // If autosolving has been turned off, client code needs
   // to explicitly call solve() before accessing variables
   // values
@@ -193,11 +718,58 @@ public:
   void SetResolveCallback( PfnResolveCallback pfn)
     { _pfnResolveCallback = pfn; }
 
+  // Called after a solve for each non-required constraint that became
+  // satisfied or stopped being satisfied ( see SetTracksSatisfaction);
+  // setting one turns the tracking on
   typedef void (*PfnCnSatCallback)( SimplexSolver * psolver, 
                                    P_Constraint pcn, bool fSatisfied);
 
   void SetCnSatCallback( PfnCnSatCallback pfn)
-    { _pfnCnSatCallback = pfn; }
+    { _pfnCnSatCallback = pfn; if ( pfn) SetTracksSatisfaction( true); }
+
+  // Whether the solver keeps track of which of its non-required
+  // constraints ( other than edits and stays) are satisfied.  It does
+  // this by noting the rows each solve touches, and checks just the
+  // constraints whose error variables are in them, rather than all of
+  // them.  The region cache is not used while tracking.  Not allowed
+  // in a transaction.
+  SimplexSolver & SetTracksSatisfaction( bool f);
+
+  bool FTracksSatisfaction() const
+    { return _fTracksSatisfaction; }
+
+  typedef vector<pair<P_Constraint, bool> > SatChangeList;
+
+  // The constraints whose satisfaction changed in the last solve, and
+  // whether each is now satisfied, in the order they were found.  A
+  // rollback reports those it changes back.  Constraints removed are
+  // not reported.
+  const SatChangeList & SatisfactionChanges() const
+    { return _satChanges; }
+
+  // Called once after each solve that moved any variable, with the
+  // variables whose values changed ( as ChangedVariables() gives them)
+  typedef void (*PfnChangesCallback)( SimplexSolver * psolver,
+                                      const VarVector & changed);
+
+  void SetChangesCallback( PfnChangesCallback pfn)
+    { _pfnChangesCallback = pfn; }
+
+  // The variables the last solve moved by more than ChangeTolerance()
+  // from the values they were last reported with, in the order they
+  // were found.  This works whether or not the solver writes the
+  // variables.
+  const VarVector & ChangedVariables() const
+    { return _changedVars; }
+
+  // How far a variable's value must move from the value it was last
+  // reported with to count as changed; 0 ( the default) counts any
+  // change
+  SimplexSolver & SetChangeTolerance( Number tolerance)
+    { _changeTolerance = tolerance; return *this; }
+
+  Number ChangeTolerance() const
+    { return _changeTolerance; }
 
 #ifndef CL_NO_IO
   friend ostream & operator<<( ostream & xo, const SimplexSolver & tableau);
@@ -207,6 +779,25 @@ public:
   ostream & PrintOnVerbose( ostream & xo) const 
     { PrintOn( xo); PrintInternalInfo( xo); xo << endl; return xo; }
 
+  // Write the constraints in the solver as a linear program in CPLEX
+  // LP format, to compare with other LP solvers.  The required
+  // constraints are hard.  Each of the others gets error variables
+  // ( one for an inequality, two for an equation) whose sum is
+  // minimized, weighted by its strength ( flattened as
+  // SymbolicWeight::AsDouble() does) times its weight.  Edits are at
+  // their last suggested values and stays at their variables' current
+  // values.  Names the format does not allow are changed.
+  ostream & WriteLP( ostream & xo) const;
+
+  // WriteLP()'s linear program in free MPS format
+  ostream & WriteMPS( ostream & xo) const;
+
+  // Write the tableau as a MatrixMarket coordinate matrix: a row for
+  // each basic variable ( the objective first), a column for each
+  // parametric variable and a last column for the rows' constants.
+  // The comments name the rows and columns.
+  ostream & WriteTableau( ostream & xo) const;
+
 #endif
 
   const ConstraintToVarMap & ConstraintMap() const
@@ -217,6 +808,15 @@ public:
 
   bool FIsConstraintSatisfied( P_Constraint pcn) const;
 
+  // Set errors[i] to how far cns[i] is from holding at the values last
+  // solved for: by how much an inequality is violated, or how far
+  // apart the sides of an equation are.  The values are the variables'
+  // own, or ValueOf()'s if the solver does not write them.  With
+  // fWeighted, each error is multiplied by the constraint's strength
+  // ( as SymbolicWeight::AsDouble() flattens it) and weight.
+  void ConstraintErrors( const vector<P_Constraint> & cns, Number * errors,
+                         bool fWeighted = false);
+
 #if CL_NO_DEPRECATED
   bool FIsConstraintSatisfied( const Constraint & pcn) const
     { return FIsConstraintSatisfied(&pcn); }
@@ -227,7 +827,7 @@ public:
   // ( which might be used to copy the Variable's value to another
   // variable)
   void UpdateExternalVariables() 
-    { SetExternalVariables(); }
+    { CatchUpTableau(); SetExternalVariables(); }
 
   // A. Beurive' Tue Jul  6 17:05:39 CEST 1999
   void ChangeStrengthAndWeight( P_Constraint , const Strength & , double weight);
@@ -264,26 +864,55 @@ public:
   // artificial variable.  To do this, create an artificial variable
   // av and Add av=expr to the inequality tableau, then make av be 0.
   // ( Raise an exception if we can't attain av=0.)
-  // ( Raise an exception if we can't attain av=0.) If the Add fails,
-  // prepare an explanation in e that describes why it failed ( note
-  // that an empty explanation is considered to mean the explanation
-  // encompasses all active constraints.
+  // Return false if we can't attain av=0.  If the Add fails, put an
+  // explanation of why in *pexplanation, if given ( note that an empty
+  // explanation is considered to mean the explanation encompasses all
+  // active constraints.
   bool AddWithArtificialVariable( P_LinearExpression , 
-                                 ExCLRequiredFailureWithExplanation & e);
+                                 ConstraintSet * pexplanation);
   
+  // Make the artificial variable av, already the subject of a row, be
+  // 0 and take it out of the tableau.  Return false ( preparing an
+  // explanation in *pexplanation, if given) if it cannot be made 0.
+  bool RemoveArtificialVariable( const Variable & av, bool fMinimize,
+                                 ConstraintSet * pexplanation);
+
   // Using the given equation ( av = cle) build an explanation which
   // implicates all constraints used to construct the equation. That
   // is, everything for which the variables in the equation are markers.
   // Thanks to Steve Wolfman for the implementation of the explanation feature
-  void BuildExplanation( ExCLRequiredFailureWithExplanation & e, 
+  void BuildExplanation( ConstraintSet & explanation, 
                         Variable av,
                         P_LinearExpression );
 
+  // Cut explanation, of why pcn could not be added, down to an
+  // irreducible conflict ( see SetMinimalExplanations), leaving it as
+  // it is if it cannot be
+  void MinimizeExplanation( P_Constraint pcn, ConstraintSet & explanation);
+
+  // The search of SnapToGrid, from vars[i] on, with cSnapped of the
+  // earlier ones snapped, keeping the values of the external variables
+  // for the most snapped so far in search
+  struct SnapSearch;
+  void SnapFrom( SnapSearch & search, size_t i, int cSnapped);
+
+  // QuickXplain: given that the constraints in the solver can all hold
+  // together, but not along with all of cns, append to conflict an
+  // irreducible subset of cns that they cannot hold along with
+  void QuickXplain( const vector<P_Constraint> & cns,
+                    vector<P_Constraint> & conflict);
+
+  // Try to add each of cns; false if one of them cannot be added
+  bool FAddedAll( const vector<P_Constraint> & cns);
+
   // We are trying to Add the constraint expr=0 to the appropriate
   // tableau.  Try to Add expr directly to the tableax without
   // creating an artificial variable.  Return true if successful and
-  // false if not.
-  bool TryAddingDirectly( P_LinearExpression );
+  // false if not: either an artificial variable is needed, or ( with
+  // status set to clsRequiredFailure, and *pexplanation explaining why
+  // if given) expr cannot be satisfied at all.
+  bool TryAddingDirectly( P_LinearExpression , ClStatus & status,
+                          ConstraintSet * pexplanation);
 
   // We are trying to Add the constraint expr=0 to the tableaux.  Try
   // to choose a subject ( a variable to become basic) from among the
@@ -303,7 +932,11 @@ public:
   // ignore whether a variable occurs in the objective function, since
   // new slack variables are added to the objective function by
   // 'NewExpression:', which is called before this method.
-  Variable ChooseSubject( P_LinearExpression );
+  // If expr is all dummy variables and a nonzero constant, it can never
+  // be satisfied: set status to clsRequiredFailure ( explaining why in
+  // *pexplanation, if given) and return nil.
+  Variable ChooseSubject( P_LinearExpression , ClStatus & status,
+                          ConstraintSet * pexplanation);
   
   // Each of the non-required edits will be represented by an equation
   // of the form
@@ -327,6 +960,35 @@ public:
   // Re-Optimize using the dual simplex algorithm.
   void DualOptimize();
 
+  // How the constant of each row changes with the value of the edit
+  // pcei, as DeltaEditConstant applies it: the rows to rates map
+  void EditRowRates( P_EditInfo pcei, VarToNumberMap & rowRates);
+
+  // Set just the external variables whose rows DeltaEditConstant
+  // changed; enough when the basis has not changed since the last
+  // SetExternalVariables
+  void SetEditedExternalVariables();
+
+  // Whether this Resolve() can use the region cache ( the values left
+  // in the tableau and tracked satisfaction would need the tableau
+  // that a hit leaves behind)
+  bool FIsRegionCaching() const
+    { return FIsRegionCacheUsable() && !_fNeedsSolving; }
+
+  // Add the critical region of the current ( optimal) basis to the
+  // region cache
+  void RecordRegion();
+
+  // If the current edit values are in a cached region, set the
+  // external variables from it, leaving the tableau behind, and
+  // return true
+  bool FResolveFromRegionCache();
+
+  // Bring the tableau up to date after Resolve() was answered from the
+  // region cache; needed before anything else looks at it
+  void CatchUpTableau()
+    { if ( _fTableauBehind) { _fTableauBehind = false; DualOptimize(); } }
+
   // Make a new linear Expression representing the constraint cn,
   // replacing any basic variables with their defining expressions.
   // Normalize if necessary so that the Constant is non-negative.  If
@@ -342,6 +1004,19 @@ public:
   // be feasible.)
   void Optimize( const Variable & zVar);
 
+  // Optimize after the active constraints changed, starting from the
+  // basis cached for them if there is one, and cache the result
+  void OptimizeFromBasisCache();
+
+  // Cache the current basis, which should be optimal, for the active
+  // constraints
+  void RememberBasis();
+
+  // Pivot to the basis cached for the active constraints and make it
+  // feasible; return false, with the tableau as it was, if none is
+  // cached or the cached one cannot be made feasible
+  bool FRestoreCachedBasis();
+
   // Do a Pivot.  Move entryVar into the basis ( i.e. make it a basic variable),
   // and move exitVar out of the basis ( i.e., make it a parametric variable)
   void Pivot( const Variable & entryVar, const Variable & exitVar);
@@ -358,16 +1033,149 @@ public:
   // them.
   void SetExternalVariables();
 
-  // this gets called by RemoveConstraint and by AddConstraint when the
-  // contraint we're trying to Add is inconsistent
+  // note that a pivot happened ( so the external variables' values
+  // might all have changed)
+  void NotePivot() { _fExternalValuesInSync = false; _fRegionRecorded = false; }
+
+  // Whether pcn is a constraint this solver can add now: clsOk, or
+  // what AddConstraint would throw, which it throws if fThrow
+  ClStatus CheckAddable( P_Constraint pcn, bool fThrow);
+
+  // The work of AddConstraint and TryAddConstraint, once pcn is known
+  // to be addable: clsOk, or clsRequiredFailure ( having explained it
+  // in *pexplanation, if given) with the tableau as it was
+  ClStatus AddConstraintInternal( P_Constraint pcn, 
+                                  ConstraintSet * pexplanation);
+
+  // this gets called by RemoveConstraint and by AddConstraints when
+  // a contraint we're trying to Add is inconsistent
   SimplexSolver & RemoveConstraintInternal( P_Constraint );
 
+  // pcn->addedTo() and removedFrom() this solver, in a way a rollback
+  // undoes
+  void NoteConstraintAdded( P_Constraint pcn);
+  void NoteConstraintRemoved( P_Constraint pcn);
+
+  // Whether none of pcn's error variables is basic and nonzero
+  bool FErrorVarsZero( P_Constraint pcn) const;
+
+  // Start or stop tracking the satisfaction of pcn, whose error
+  // variables have just been added or are about to be removed
+  void NoteErrorVarsAdded( P_Constraint pcn);
+  void NoteErrorVarsRemoved( P_Constraint pcn);
+
+  // Keep weight as this solver's weight for pcn's error variables
+  // ( unless pcn is an edit constraint)
+  void NoteErrorWeight( P_Constraint pcn, Number weight);
+
+  // After a solve, check the constraints with error variables in the
+  // rows touched, and report those whose satisfaction changed
+  void UpdateSatisfaction();
+
+  // Record and report that pcn became satisfied or not
+  void NoteSatisfaction( P_Constraint pcn, bool fSatisfied);
+
+  // After a rollback, report the constraints it changed back
+  void ReportRolledBackSatisfaction();
+
+  // Start logging changes in _journal, for a transaction or for
+  // AddConstraint() to back out of a constraint it cannot add, and
+  // return the number of changes logged before
+  size_t BeginJournal();
+
+  // Keep the changes logged, or undo those logged since there were
+  // cEntries; then stop logging unless a transaction is still open
+  void CommitJournal();
+  void RollbackJournal( size_t cEntries);
+
+  // Throw ExCLTransactionMisuse if a transaction is open, since it
+  // could not undo szWhat
+  void CheckNoTransaction( const char * szWhat) const;
+
+  // Log v's value before Changev() changes it
+  void JournalValue( const Variable & v);
+
+  // Log map[key] before changing it, if logging
+  template <class M>
+  void JournalEntry( M & map, const typename M::key_type & key)
+    { if ( _pjournal) _pjournal->SaveEntry( map, key); }
+
+  // The part of RemoveConstraintInternal that takes pcn's variables
+  // out of the tableau, without resetting the stays or optimizing
+  void RemoveConstraintRows( P_Constraint pcn);
+
+  // Remove all of cns ( cheapest first) without optimizing; like
+  // RemoveConstraintInternal, but resetting the stays only once
+  void RemoveConstraintsInternal( const vector<P_Constraint> & cns);
+
+  // Pivot marker into the basis and drop its row
+  void RemoveMarkerRow( const Variable & marker);
+
+  // Remove all the stays on each of vars, resetting the stay constants
+  // and re-optimizing only once; vars must not be used by other
+  // constraints
+  void RemoveStays( const VarVector & vars);
+
+  // Take the stay error variables in eVars out of _stayPlusErrorVars
+  // and _stayMinusErrorVars ( or leave them to RemoveStays() to take
+  // out with the others it removes)
+  void RemoveStayErrorVars( const VarSet & eVars);
+
+  // Sweep the variables whose last user constraint was removed since
+  // the previous sweep
+  void RemoveUnusedVariableCandidates();
+
+  // The named group; throws if there is none
+  ConstraintGroup & FindGroup( const string & name);
+
+  // Add the constraints of a group, or remove those of several groups
+  // at once, without re-optimizing
+  void AddGroupConstraints( ConstraintGroup & group);
+  void RemoveGroupConstraints( const vector<ConstraintGroup * > & groups);
+
+  // The coefficient of pcn's error variables in the objective
+  Number ErrorWeight( P_Constraint pcn) const;
+
+  // Change the coefficient of pcn's error variables in the objective
+  // to coeff, without optimizing.  Returns true if it changed.  For an
+  // edit constraint the new coefficient is kept in its EditInfo, not
+  // in the constraint.
+  bool SetErrorWeight( P_Constraint pcn, Number coeff);
+
+  // Bring the parked edit slot pcei into use with the given strength
+  // and weight, or park it again
+  void ActivateEditSlot( P_EditInfo pcei, const Strength & strength, double weight);
+  void ParkEditSlot( P_EditInfo pcei);
+
+  // Let pcnNew stand in the tableau for pcnOld, which says the same
+  // thing
+  void ReplaceConstraint( P_Constraint pcnOld, P_Constraint pcnNew);
+
+  // Return a slack, dummy or error variable kept for reuse if it is
+  // no longer anywhere in the tableau, otherwise nil
+  Variable ReusableVariable( const Variable & v) const
+    { return ( v.IsNil() || FIsBasicVar( v) || ColumnsHasKey( v))? clvNil : v; }
+
   void Changev( Variable clv, Number n) {
-    clv.ChangeValue( n); 
-    if ( _pfnChangevCallback) 
-      _pfnChangevCallback(&clv,this);
+    NoteNewValue( clv, n);
+    if ( !_fWritesVariables)
+      return;
+    WriteValue( clv, n);
   }
 
+  // Changev() whether or not the solver writes the variables, but
+  // without adding clv to the changed variables
+  void WriteValue( Variable clv, Number n);
+
+  // Add v to the changed variables if n is further than the change
+  // tolerance from the value last reported for v
+  void NoteNewValue( const Variable & v, Number n);
+
+  // v's value as last solved for: v's own, unless the solver does not
+  // write the variables ( ValueOf() has any snapped value)
+  Number SolvedValue( const Variable & v) const
+    { return _fWritesVariables? v.Value() : ValueOf( v); }
+
   /// instance variables
 
   // the arrays of positive and negative error vars for the stay constraints
@@ -375,10 +1183,21 @@ public:
   VarVector _stayMinusErrorVars;
   VarVector _stayPlusErrorVars;
 
+  // while RemoveStays() is removing the stays of several variables,
+  // the stay error variables to take out of the two arrays above
+  // together once it is done
+  VarSet * _psweptStayErrorVars;
+
   // give error variables for a non required constraint,
   // maps to SlackVariable-s
   ConstraintToVarSetMap _errorVars;
 
+  // the weight of the error variables of each non-required constraint
+  // other than an edit ( whose EditInfo keeps it) in the objective.
+  // Other solvers may share the constraint and change its strength and
+  // weight, so this solver keeps its own.
+  ConstraintToNumberMap _errorWeights;
+
   // Return a lookup table giving the marker variable for each
   // constraint ( used when deleting a constraint).
   ConstraintToVarMap _markerVars;
@@ -393,6 +1212,29 @@ public:
   // values
   EditInfoList _editInfoList;
 
+  // the first ( full) _editInfoList entry for each edit variable
+  VarToEditInfoMap _editInfoMap;
+
+  // the persistent edit slots, whether in use or parked
+  VarToEditInfoMap _editSlots;
+
+  // the stay constraints on each variable ( used when retiring
+  // variables that are no longer needed)
+  VarToConstraintSetMap _stayConstraints;
+
+  // the number of constraints, other than stays and edits, in which
+  // each external variable occurs
+  VarToIntMap _varUseCounts;
+
+  // variables with stays whose use count dropped to zero since the
+  // last sweep ( only kept when removing them automatically)
+  VarSet _unusedVarCandidates;
+
+  // the constraint groups by name, and what was prepared for each
+  // grouped constraint
+  ConstraintGroupMap _groups;
+  PreparedConstraintMap _preparedConstraints;
+
   int _slackCounter;
   int _artificialCounter;
 #ifdef CL_FIND_LEAK
@@ -402,11 +1244,61 @@ public:
   const double _epsilon;
 
   bool _fResetStayConstantsAutomatically;
+  bool _fRemoveUnusedVariablesAutomatically;
   bool _fNeedsSolving;
+
+  // true while the external variables hold the tableau's values, apart
+  // from those in _editedExternalRows
+  bool _fExternalValuesInSync;
+  VarSet _editedExternalRows;
   bool _fExplainFailure;
+  bool _fMinimalExplanations;
+  bool _fWritesVariables;
+  unsigned long _cSolutions;
+
+  // the region cache, most recently used first; whether the current
+  // basis's region is in it; whether the tableau is behind the values
+  // last set from it
+  CriticalRegionList _regions;
+  size_t _cRegionCacheLimit;
+  bool _fRegionRecorded;
+  bool _fTableauBehind;
+  long _cRegionCacheHits;
+  long _cRegionCacheMisses;
+
+  // see ActiveFingerprint(); the basis cache, most recently used first
+  size_t _activeFingerprint;
+  CachedBasisList _bases;
+  size_t _cBasisCacheLimit;
+  long _cBasisCacheHits;
+  long _cBasisCacheMisses;
 
   PfnResolveCallback _pfnResolveCallback;
   PfnCnSatCallback _pfnCnSatCallback;
+  PfnChangesCallback _pfnChangesCallback;
+
+  // for SetTracksSatisfaction(): the tracked constraint of each error
+  // variable, the tracked constraints not satisfied, the rows touched
+  // since the last solve, the changes found in it, and the changes
+  // reported while logging ( for a rollback to report them undone)
+  bool _fTracksSatisfaction;
+  VarToConstraintMap _errorVarOwners;
+  ConstraintSet _unsatisfiedCns;
+  VarVector _touchedRows;
+  SatChangeList _satChanges;
+  SatChangeList _satChangesLogged;
+
+  // the variables changed in the current solve, for ChangedVariables()
+  VarVector _changedVars;
+  Number _changeTolerance;
+
+  // the value each variable had when it was last reported changed ( or
+  // when the solver first set it)
+  VarToNumberMap _reportedValues;
+
+  // the values SnapToGrid left the external variables with, which
+  // ValueOf() gives instead of the tableau's until the next solve
+  VarToNumberMap _snappedValues;
 
 #ifdef CL_PV
   // C-style extension mechanism so I
@@ -420,6 +1312,18 @@ public:
   // to the # of constraints as in _stkCedcns.top()
   stack<int> _stkCedcns;
 
+  // the changes logged for the open transactions ( and for the
+  // AddConstraint() in progress), and the number logged before each
+  // transaction began
+  Journal _journal;
+  vector<size_t> _transactionMarks;
+
+  // Undo a NoteConstraintAdded/Removed(), or a Changev()
+  class ConstraintJournalEntry;
+  class ValueJournalEntry;
+  friend class ConstraintJournalEntry;
+  friend class ValueJournalEntry;
+
 };
 
 
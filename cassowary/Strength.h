@@ -64,15 +64,15 @@ class Strength {
   virtual const SymbolicWeight & symbolicWeight() const
     { return _symbolicWeight; }
 
+  string Name() const
+    { return _name; }
+
 #ifdef CL_PV
   void SetPv( void * pv) { _pv = pv; } 
   void * Pv() const { return _pv; }
 #endif
 
  private:
-  string Name() const
-    { return _name; }
-
   void SetName( string Name)
     { _name = Name; }
 
@@ -145,6 +145,9 @@ class SymbolicWeight {
   int CLevels() const
     { return _values.size(); }
 
+  const vector<Number> & Values() const
+    { return _values; }
+
 //  friend bool Approx( const SymbolicWeight & cl, Number n);
 //  friend bool Approx( const SymbolicWeight & cl1, const SymbolicWeight & cl2);
     bool Approx( Number n) const;
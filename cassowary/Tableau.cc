@@ -24,6 +24,7 @@ void Tableau::NoteRemovedVariable( const Variable & v, const Variable & subject)
     Tracer TRACER( __FUNCTION__);
     cerr << "(" << v << ", " << subject << ")" << endl;
 #endif
+    JournalColumnMember( v, subject);
     VarSet & column = _columns[v];
     VarSet::const_iterator it = column.find( subject);
     assert( it != column.end());
@@ -34,8 +35,11 @@ void Tableau::NoteRemovedVariable( const Variable & v, const Variable & subject)
 #endif
     if ( column.size() == 0)
       {
+      JournalColumn( v);
       _columns.erase( v);
+      JournalMember( _externalRows, v, false);
       _externalRows.erase( v);
+      JournalMember( _externalParametricVars, v, false);
       _externalParametricVars.erase( v);
       }
     }
@@ -48,9 +52,11 @@ void Tableau::NoteAddedVariable( const Variable & v, const Variable & subject)
     Tracer TRACER( __FUNCTION__);
     cerr << "(" << v << ", " << subject << ")" << endl;
 #endif
+    JournalColumnMember( v, subject);
     _columns[v].insert( subject); 
     if ( v.IsExternal() && !FIsBasicVar( v))
       {
+      JournalMember( _externalParametricVars, v, true);
       _externalParametricVars.insert( v);
       }
     }
@@ -155,21 +161,27 @@ void Tableau::addRow( const Variable & var, P_LinearExpression expr)
   Tracer TRACER( __FUNCTION__);
   cerr << "(" << var << ", " << expr << ")" << endl;
 #endif
+  JournalRow( var);
+  NoteRowTouched( var);
   _rows[var] = expr;//const_cast<LinearExpression * >(&expr);
+  _sharedRows.erase( var);
   // for each variable in expr, Add var to the set of rows which have that variable
   // in their Expression
   VarToNumberMap::const_iterator it = expr->Terms().begin();
   for (; it != expr->Terms().end(); ++it)
     {
     Variable v = (*it).first;
+    JournalColumnMember( v, var);
     _columns[v].insert( var);
     if ( v.IsExternal() && !FIsBasicVar( v))
       {
+      JournalMember( _externalParametricVars, v, true);
       _externalParametricVars.insert( v);
       }
     }
   if ( var.IsExternal())
     {
+    JournalMember( _externalRows, var, true);
     _externalRows.insert( var);
     }
 #ifdef CL_TRACE
@@ -177,6 +189,83 @@ void Tableau::addRow( const Variable & var, P_LinearExpression expr)
 #endif
 }
 
+const VarSet &
+Tableau::ConstColumn( const Variable & v) const
+{
+  static const VarSet empty;
+  TableauColumnsMap::const_iterator it = _columns.find( v);
+  return ( it != _columns.end())? (*it).second : empty;
+}
+
+// The coefficients a row had for some variables, and its constant,
+// to put back
+class RowTermsJournalEntry : public Journal::Entry {
+ public:
+  RowTermsJournalEntry( P_LinearExpression prow)
+      : _prow( prow), _constant( prow->Constant())
+    { }
+  void Save( const Variable & v)
+    {
+    const VarToNumberMap & terms = _prow->Terms();
+    VarToNumberMap::const_iterator it = terms.find( v);
+    if ( it == terms.end())
+      _absent.push_back( v);
+    else
+      _present.push_back( *it);
+    }
+  void Undo()
+    {
+    VarToNumberMap & terms = _prow->Terms();
+    vector<Variable>::const_iterator it_absent = _absent.begin();
+    for ( ; it_absent != _absent.end(); ++it_absent)
+      terms.erase(*it_absent);
+    vector<pair<Variable, Number> >::const_iterator it_present = _present.begin();
+    for ( ; it_present != _present.end(); ++it_present)
+      terms[(*it_present).first] = (*it_present).second;
+    _prow->Set_constant( _constant);
+    }
+ private:
+  P_LinearExpression _prow;
+  Number _constant;
+  vector<pair<Variable, Number> > _present;
+  vector<Variable> _absent;
+};
+
+void
+Tableau::JournalTerms( P_LinearExpression prow, const Variable & v)
+{
+  if ( !_pjournal)
+    return;
+  RowTermsJournalEntry * pentry = new RowTermsJournalEntry( prow);
+  if ( !v.IsNil())
+    pentry->Save( v);
+  _pjournal->Add( pentry);
+}
+
+void
+Tableau::JournalTerms( P_LinearExpression prow, const LinearExpression & expr,
+                       const Variable & v)
+{
+  if ( !_pjournal)
+    return;
+  RowTermsJournalEntry * pentry = new RowTermsJournalEntry( prow);
+  if ( !v.IsNil())
+    pentry->Save( v);
+  VarToNumberMap::const_iterator it = expr.Terms().begin();
+  for ( ; it != expr.Terms().end(); ++it)
+    pentry->Save( (*it).first);
+  _pjournal->Add( pentry);
+}
+
+void Tableau::ShareRows() const
+{
+  TableauRowsMap::const_iterator it = _rows.begin();
+  for (; it != _rows.end(); ++it)
+    {
+    _sharedRows.insert( (*it).first);
+    }
+}
+
 // Remove var from the tableau -- remove the column cross indices for var
 // and remove var from every Expression in rows in which v occurs
 // Remove the parametric variable var, updating the appropriate column and row entries.
@@ -198,14 +287,19 @@ Tableau::RemoveColumn( const Variable & var)
   for (; it != varset.end(); ++it)
     {
     Variable v = (*it);
-    VarToNumberMap & Terms = _rows[v]->Terms();
+    P_LinearExpression prow = RowExpression( v);
+    JournalTerms( prow, var);
+    VarToNumberMap & Terms = prow->Terms();
     Terms.erase( Terms.find( var));
     }
   if ( var.IsExternal())
     {
+    JournalMember( _externalRows, var, false);
     _externalRows.erase( var);
+    JournalMember( _externalParametricVars, var, false);
     _externalParametricVars.erase( var);
     }
+  JournalColumn( var);
   _columns.erase( it_var);
   return var;
 }
@@ -220,16 +314,32 @@ P_LinearExpression Tableau::RemoveRow( const Variable & var)
 #endif
   TableauRowsMap::iterator it = _rows.find( var);
   assert( it != _rows.end());
+  NoteRowTouched( var);
+  // the caller usually changes the row and adds it back
+  if ( _pjournal)
+    {
+    // ( so the row is copied for it, leaving the logged one as it is)
+    JournalRow( var);
+    (*it).second = new LinearExpression( *(*it).second);
+    _sharedRows.erase( var);
+    }
+  else
+    {
+    OwnRow( it);
+    }
   P_LinearExpression pexpr = (*it).second;
   VarToNumberMap & Terms = pexpr->Terms();
   VarToNumberMap::iterator it_term = Terms.begin();
   for (; it_term != Terms.end(); ++it_term)
     {
     const Variable & v = (*it_term).first;
+    JournalColumnMember( v, var);
     _columns[v].erase( var);
     if ( _columns[v].size() == 0)
       {
+      JournalColumn( v);
       _columns.erase( v);
+      JournalMember( _externalParametricVars, v, false);
       _externalParametricVars.erase( v);
       }
     }
@@ -238,7 +348,9 @@ P_LinearExpression Tableau::RemoveRow( const Variable & var)
 
   if ( var.IsExternal())
     {
+    JournalMember( _externalRows, var, false);
     _externalRows.erase( var);
+    JournalMember( _externalParametricVars, var, false);
     _externalParametricVars.erase( var);
     }
 
@@ -273,20 +385,25 @@ Tableau::SubstituteOut( const Variable & oldVar, P_LinearExpression expr)
   for (; it != varset.end(); ++it)
     {
     const Variable & v = (*it);
-    P_LinearExpression prow = _rows[v];
+    P_LinearExpression prow = RowExpression( v);
+    JournalTerms( prow, *expr, oldVar);
+    NoteRowTouched( v);
     prow->SubstituteOut( oldVar,*expr,v,*this);
     if ( v.IsRestricted() && prow->Constant() < 0.0)
       {
       _infeasibleRows.insert( v);
       }
     }
+  JournalColumn( oldVar);
   _columns.erase( it_oldVar);
   if ( oldVar.IsExternal())
     {
     if ( _columns[oldVar].size() > 0) 
       {
+      JournalMember( _externalRows, oldVar, true);
       _externalRows.insert( oldVar);
       }
+    JournalMember( _externalParametricVars, oldVar, false);
     _externalParametricVars.erase( oldVar);
     }
 }
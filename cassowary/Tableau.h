@@ -21,6 +21,7 @@
 #include "LinearExpression.h"
 #include "Variable.h"
 #include "Typedefs.h"
+#include "Journal.h"
 
 
 #ifndef CL_NO_IO
@@ -64,6 +65,8 @@ class Tableau {
  protected:
   // Constructor -- want to start with empty objects so not much to do
   Tableau()
+      : _pjournal( NULL),
+        _ptouchedRows( NULL)
     { }
 
   virtual ~Tableau();
@@ -107,6 +110,40 @@ class Tableau {
     else
       return NULL;
     }
+
+  // As above, but the row is made this tableau's own first, since the
+  // caller may change it ( see ShareRows)
+  P_LinearExpression RowExpression( const Variable & v)
+    {
+    TableauRowsMap::iterator i = _rows.find( v);
+    if ( i == _rows.end())
+      return NULL;
+    if ( !_sharedRows.empty())
+      OwnRow( i);
+    return (*i).second;
+    }
+
+  // The row for v, for reading only: never copies a shared row
+  P_LinearExpression ConstRowExpression( const Variable & v) const
+    { return RowExpression( v); }
+
+  // Mark every row as shared with a copy of this tableau.  Copying a
+  // tableau copies the row map but not the expressions in it, so call
+  // this on the source first; the marks are copied with the map, and
+  // each tableau then copies a row the first time it changes it.
+  void ShareRows() const;
+
+  // Replace the row at i by a copy of it if it is shared
+  void OwnRow( TableauRowsMap::iterator i)
+    {
+    VarSet::iterator it = _sharedRows.find( (*i).first);
+    if ( it != _sharedRows.end())
+      {
+      JournalRow( (*i).first);
+      (*i).second = new LinearExpression( *(*i).second);
+      _sharedRows.erase( it);
+      }
+    }
 /*
   LinearExpression * RowExpression( Variable v)
     {
@@ -118,6 +155,65 @@ class Tableau {
   bool FIsBasicVar( const Variable & v) const
     { return RowExpression( v) != NULL; }
 
+  // The rows with v in them ( none if v has no column), without making
+  // a column for it
+  const VarSet & ConstColumn( const Variable & v) const;
+
+  // Log the changes to the tableau in *pjournal, or stop logging them
+  // if it is NULL
+  void SetJournal( Journal * pjournal)
+    { _pjournal = pjournal; }
+
+  // The Journal...() functions log what is about to change, if there
+  // is a journal.  Rows are logged a term at a time when they are
+  // changed in place, and whole when they are replaced or removed.
+
+  // v's row is about to be replaced or removed
+  void JournalRow( const Variable & v)
+    {
+    if ( _pjournal)
+      {
+      _pjournal->SaveEntry( _rows, v);
+      JournalMember( _sharedRows, v, false);
+      }
+    }
+
+  // The constant of *prow and its coefficient for v ( unless v is
+  // nil) are about to change
+  void JournalTerms( P_LinearExpression prow, const Variable & v);
+
+  // ... or its coefficients for v and for expr's variables, as when
+  // adding a multiple of expr to it or substituting expr for v
+  void JournalTerms( P_LinearExpression prow, const LinearExpression & expr,
+                     const Variable & v);
+
+  // v's column is about to be erased
+  void JournalColumn( const Variable & v)
+    {
+    if ( _pjournal)
+      _pjournal->SaveEntry( _columns, v);
+    }
+
+  // subject is about to be inserted into v's column ( made if need be)
+  // or erased from it
+  void JournalColumnMember( const Variable & v, const Variable & subject)
+    {
+    if ( _pjournal)
+      _pjournal->SaveMapMember( _columns, v, subject);
+    }
+
+  // v is about to be inserted into set ( fIn) or erased from it
+  void JournalMember( VarSet & set, const Variable & v, bool fIn)
+    {
+    if ( _pjournal && ( set.find( v) != set.end()) != fIn)
+      _pjournal->SaveMember( set, v);
+    }
+
+  // v's row is about to be added, removed, or have its constant
+  // changed; note it if the rows touched are being noted
+  void NoteRowTouched( const Variable & v)
+    { if ( _ptouchedRows) _ptouchedRows->push_back( v); }
+
   // private: FIXGJB: can I improve the encapsulation?
 
   // _columns is a mapping from variables which occur in expressions to the
@@ -141,6 +237,17 @@ class Tableau {
   // this was added to the C++ version to reduce time in SetExternalVariables()
   VarSet _externalParametricVars;
 
+  // the basic variables whose row expressions may also be in another
+  // tableau's _rows, and so have to be copied before being changed
+  // ( mutable, since copying a tableau shares the rows of both)
+  mutable VarSet _sharedRows;
+
+  // where changes are logged, if anywhere
+  Journal * _pjournal;
+
+  // where NoteRowTouched() notes rows, if anywhere
+  VarVector * _ptouchedRows;
+
 };
 
 #endif
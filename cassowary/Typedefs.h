@@ -42,6 +42,7 @@ typedef Map<P_Constraint, VarSet> ConstraintToVarSetMap;
 typedef Map<P_Constraint, Variable> ConstraintToVarMap;
 typedef Map<Variable, P_Constraint > VarToConstraintMap;
 typedef vector<Variable> VarVector;
+typedef Map<Variable, int> VarToIntMap;
 
 typedef Set<P_Constraint > ConstraintSet;
 
@@ -87,6 +87,9 @@ public:
   }
 
   AbstractVariable * get_pclv() const { return pclv.ptr(); } 
+  // the serial number of the variable ( see AbstractVariable::Id()),
+  // or 0 for clvNil
+  long Id() const { return pclv.ptr()? pclv->Id() : 0; }
   bool IsNil() const { return pclv == NULL; }
 /*
   //virtual 
@@ -107,7 +110,7 @@ public:
 #endif
 
   friend bool operator<( const Variable & cl1, const Variable & cl2)
-    { return cl1.pclv.ptr() < cl2.pclv.ptr(); }
+    { return cl1.Id() > cl2.Id(); }
 
   bool operator == ( const Variable & cl2) const { return pclv == cl2.pclv; } 
   bool operator != ( const Variable & cl2) const { return pclv != cl2.pclv; }
@@ -121,7 +124,7 @@ inline ostream & operator<<( ostream & xo, const Variable & clv)
 #ifdef CL_USE_HASH_MAP_AND_SET
 struct hash<Variable> { 
   size_t operator()( const Variable & v) const
-    { return size_t(( unsigned long)v.get_pclv()/CL_PTR_HASH_DIVISOR);  }
+    { return size_t( v.Id());  }
 };
 #endif
 
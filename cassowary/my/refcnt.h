@@ -2,6 +2,16 @@
 #ifndef REF_CNT_H
 #define REF_CNT_H
 
+ // add d to *pn atomically and return the new value, so that objects
+ // shared between solvers in different threads can be counted
+ // ( see SimplexSolver::SolveScenarios)
+#ifdef _MSC_VER
+#include <intrin.h>
+#define ATOMIC_ADD( pn, d)  ( _InterlockedExchangeAdd( (long volatile *)(pn), (d)) + (d))
+#else
+#define ATOMIC_ADD( pn, d)  __sync_add_and_fetch( (pn), (d))
+#endif
+
  // reference counter - to go with RefCountPtr<>
  // inherit as public or make member and export inc/dec/n()
 class RefCount {
@@ -13,19 +23,19 @@ public:
     void operator = (const RefCount &)  {}      //nothing!
 // ~RefCount()                  {}              // assert/message if still used
     int  nref() const           { return _n; }
-    void incref()               { _n++; }
-    void decref()               { _n--; }
+    void incref()               { ATOMIC_ADD( &_n, 1); }
+    int  decref()               { return ATOMIC_ADD( &_n, -1); }   //the count left
 };
         //put inside your class
 #define REFCOUNT_DEF    RefCount _refcnt;       \
 public: void incref()       { _refcnt.incref(); }  \
-        void decref()       { _refcnt.decref(); }  \
+        int  decref()       { return _refcnt.decref(); }  \
         int  nref() const   { return _refcnt.nref(); }
 
         //put outside - global scope, external
 #define REFCOUNT_INST(Type)     \
 void incref( Type * p)  { p->incref(); }  \
-void decref( Type * p, int del)  { p->decref(); if (del && !p->nref()) delete p; }
+void decref( Type * p, int del)  { if (!p->decref() && del) delete p; }
 //use template<> ...func... if func is declared as template in refcntp.h
 
 #ifdef TRACE_REFCOUNT_DIE
@@ -4,10 +4,14 @@
 from cython.operator cimport dereference as deref
 from cython.operator cimport preincrement as inc
 from libc.math cimport fabs
+from libcpp cimport bool as cppbool
 from libcpp.string cimport string
+from libcpp.utility cimport pair
 from libcpp.vector cimport vector
+from cython.view cimport array as cvarray
 
 import operator
+import weakref
 from collections import defaultdict
 
 
@@ -60,6 +64,25 @@ cdef int raise_cassowary_error() except *:
     raise e
 
 
+cdef extern from "cassowary/Errors.h":
+    cdef enum ClStatus:
+        clsOk
+        clsRequiredFailure
+        clsTooDifficult
+        clsEditMisuse
+        clsConstraintNotFound
+        clsTransactionMisuse
+
+# What the exceptions the Try...() functions stand in for would say.
+_status_messages = {
+    clsRequiredFailure: 'ExCLRequiredFailure: A required constraint cannot be satisfied',
+    clsTooDifficult: 'ExCLTooDifficult: The constraints are too difficult to solve',
+    clsEditMisuse: 'ExCLEditMisuse: Edit protocol usage violation',
+    clsConstraintNotFound: 'ExCLConstraintNotFound: Tried to remove a constraint that was never added',
+    clsTransactionMisuse: 'ExCLTransactionMisuse: Transaction protocol usage violation',
+}
+
+
 cdef extern from "cassowary/SymbolicWeight.h":
     cdef cppclass ClSymbolicWeight "SymbolicWeight":
         ClSymbolicWeight (vector[double] weights)
@@ -75,12 +98,15 @@ cdef extern from "cassowary/Strength.h":
 
 cdef extern from "cassowary/Variable.h":
     cdef cppclass ClVariable "Variable":
-          #ClVariable(ClVariable clv_)
+          ClVariable(ClVariable clv_)
           ClVariable(string name, double Value) 
           #ClVariable(double Value=0.0) 
+          string Name()
           double Value()
           void SetValue(double value)
 
+    ClVariable clvNil
+
 cdef extern from "cassowary/LinearExpression.h":
     cdef cppclass ClLinearExpression "LinearExpression":
         ClLinearExpression(double num)
@@ -111,6 +137,7 @@ cdef extern from "cassowary/Constraint.h":
 
 cdef extern from "cysw_support.h":
     size_t get_P_Constraint_addr(P_Constraint *pcn)
+    size_t get_Variable_addr(ClVariable v)
 
 cdef extern from "cassowary/LinearEquation.h":
     cdef cppclass ClLinearEquation "LinearEquation":
@@ -129,15 +156,36 @@ cdef extern from "cassowary/LinearInequality.h":
     ctypedef ClLinearInequality* P_LinearInequality
 
 cdef extern from "cassowary/SimplexSolver.h":
+    cdef cppclass ClEditHandle "SimplexSolver::EditHandle":
+        pass
+
+    cdef cppclass ClScenario "SimplexSolver::Scenario":
+        vector[P_Constraint] _constraints
+        vector[ClVariable] _editVars
+        vector[double] _editValues
+
     cdef cppclass ClSimplexSolver "SimplexSolver":
         ClSimplexSolver()
+        ClSimplexSolver *Clone() except +raise_cassowary_error
+        void Save(string bytes, vector[ClVariable] *pExternals, vector[P_Constraint] *pConstraints) except +raise_cassowary_error
+        void SaveFile(char *path, vector[ClVariable] *pExternals, vector[P_Constraint] *pConstraints) except +raise_cassowary_error
         # Note: most of these void return types actually should be
         # ClSimplexSolver&, but we don't use the return values, and it causes
         # problems in the generated C++.
         void AddConstraint(P_Constraint pcn) except +raise_cassowary_error
+        int AddConstraints(vector[P_Constraint] cns, vector[P_Constraint] *pFailed) except +raise_cassowary_error nogil
         void RemoveConstraint(P_Constraint pcn) except +raise_cassowary_error
+        void RemoveConstraints(vector[P_Constraint] cns) except +raise_cassowary_error
+        ClStatus TryRemoveConstraint(P_Constraint pcn) except +raise_cassowary_error
+        void Reconcile(vector[P_Constraint] desired) except +raise_cassowary_error
+        void BeginTransaction() except +raise_cassowary_error
+        void CommitTransaction() except +raise_cassowary_error
+        void RollbackTransaction() except +raise_cassowary_error
+        bint FInTransaction()
         void AddEditVar(ClVariable v, ClStrength strength, double weight) except +raise_cassowary_error
         void RemoveEditVar(ClVariable v) except +raise_cassowary_error
+        void AddEditSlot(ClVariable v) except +raise_cassowary_error
+        void RemoveEditSlot(ClVariable v) except +raise_cassowary_error
         void BeginEdit() except +raise_cassowary_error
         void EndEdit() except +raise_cassowary_error
         void RemoveAllEditVars()
@@ -146,18 +194,47 @@ cdef extern from "cassowary/SimplexSolver.h":
         void Resolve() except +raise_cassowary_error
         void SetAutosolve(bint f) except +raise_cassowary_error
         void SuggestValue(ClVariable v, double x) except +raise_cassowary_error
+        ClEditHandle EditHandleFor(ClVariable v) except +raise_cassowary_error
+        void SuggestValues(ClEditHandle *handles, double *values, size_t n) except +raise_cassowary_error
         void Reset()
+        bint FIsAutosolving()
         void SetExplaining(bint f)
         bint FIsExplaining()
+        void SetMinimalExplanations(bint f)
+        bint FIsMinimalExplanations()
+        void SetWritesVariables(bint f) except +raise_cassowary_error
+        bint FWritesVariables()
+        double ValueOf(ClVariable v)
+        void UpdateValues(vector[ClVariable] vars) except +raise_cassowary_error
+        unsigned long SolutionNumber()
+        vector[ClVariable] ChangedVariables()
+        void SetChangeTolerance(double tolerance)
+        double ChangeTolerance()
+        void SetTracksSatisfaction(bint f) except +raise_cassowary_error
+        bint FTracksSatisfaction()
+        vector[pair[P_Constraint, cppbool]] SatisfactionChanges()
+        void ConstraintErrors(vector[P_Constraint] cns, double *errors, bint fWeighted) except +raise_cassowary_error
         void Solve()
         bint FContainsVariable(ClVariable v) except +raise_cassowary_error
+        size_t SolveScenarios(vector[ClScenario] scenarios, vector[ClVariable] vars, double *values, int cThreads) except +raise_cassowary_error nogil
+        int SnapToGrid(vector[ClVariable] vars, double grid, int cTrialsMax) except +raise_cassowary_error
 
 cdef extern from "cysw_support.h":
     string solver_str(ClSimplexSolver *solver)
+    int try_add_constraint(ClSimplexSolver *solver, P_Constraint cn, vector[size_t] *explanation) except +raise_cassowary_error
     P_Constraint *newLinearEquation(P_LinearExpression lhs, P_LinearExpression rhs, ClStrength strength, double weight)
     P_Constraint *newLinearInequality(P_LinearExpression lhs, ClCnRelation op, P_LinearExpression rhs, ClStrength strength, double weight)
     P_LinearExpression newLinearExpression(double constant)
     void delete_P_Constraint(P_Constraint *pcn)
+    ClSimplexSolver *load_solver(string bytes, vector[ClVariable] *bindVars, vector[P_Constraint] *bindCns, vector[ClVariable] *externals, vector[P_Constraint] *cns) except +raise_cassowary_error
+    ClSimplexSolver *load_solver_file(string path, vector[ClVariable] *bindVars, vector[P_Constraint] *bindCns, vector[ClVariable] *externals, vector[P_Constraint] *cns) except +raise_cassowary_error
+    string export_solver(ClSimplexSolver *solver, string format) except +raise_cassowary_error
+    void read_model(ClSimplexSolver *solver, string source, bint fFile, vector[string] *names, vector[ClVariable] *vars, vector[P_Constraint] *failed) except +raise_cassowary_error nogil
+
+# The ConstraintVariables and LinearConstraints alive, by the address of
+# the C++ object each wraps, so that a saved Solver can refer to them.
+_variables_by_addr = weakref.WeakValueDictionary()
+_constraints_by_addr = weakref.WeakValueDictionary()
 
 cdef class SymbolicWeight:
     cdef ClSymbolicWeight *symbolic_weight
@@ -189,6 +266,9 @@ cdef class SymbolicWeight:
     def __repr__(self):
         return 'SymbolicWeight({0!r})'.format(self.weights)
 
+    def __reduce__(self):
+        return (SymbolicWeight, (self.weights,))
+
     def __hash__(self):
         return object.__hash__(self)
 
@@ -218,6 +298,9 @@ cdef class Strength:
     def __str__(self):
         return repr(self.name)
 
+    def __reduce__(self):
+        return (Strength, (self.name, self.symbolic_weight, self.is_required))
+
     def __hash__(self):
         return object.__hash__(self)
 
@@ -361,10 +444,12 @@ cdef class LinearSymbolic:
 cdef class ConstraintVariable(LinearSymbolic):
     cdef ClVariable *variable
     cdef readonly bytes name
+    cdef object __weakref__
 
     def __cinit__(self, bytes name, double value=0.0):
         self.variable = new ClVariable(string(<char*>name), value)
         self.name = name
+        _variables_by_addr[get_Variable_addr(deref(self.variable))] = self
 
     property value:
         def __get__(self):
@@ -376,6 +461,9 @@ cdef class ConstraintVariable(LinearSymbolic):
     def __repr__(self):
         return 'ConstraintVariable({0!r}, {1!r})'.format(self.name, self.variable.Value())
 
+    def __reduce__(self):
+        return (ConstraintVariable, (self.name, self.variable.Value()))
+
     def __str__(self):
         return '{0}:{1}'.format(self.name, self.value)
 
@@ -432,6 +520,9 @@ cdef class Term(LinearSymbolic):
     def __repr__(self):
         return 'Term({0!r}, {1!r})'.format(self.var, self.coeff)
 
+    def __reduce__(self):
+        return (Term, (self.var, self.coeff))
+
     def __str__(self):
         if self.coeff == 1.0:
             template = '{name}:{value}'
@@ -499,6 +590,9 @@ cdef class LinearExpression(LinearSymbolic):
         self.terms = self.reduce_terms(terms)
         self.constant = constant
 
+    def __reduce__(self):
+        return (LinearExpression, (self.terms, self.constant))
+
     property value:
         def __get__(self):
             cdef double value=self.constant
@@ -595,6 +689,7 @@ cdef class LinearConstraint:
     cdef double _weight
     cdef readonly bytes op
     cdef P_Constraint *cl_linear_constraint
+    cdef object __weakref__
 
     def __cinit__(self, lhs, rhs, *args, **kwds):
         self.lhs = as_linear_expression(lhs)
@@ -604,6 +699,8 @@ cdef class LinearConstraint:
         self._strength = strength
         self._weight = weight
         self.cl_linear_constraint = self.as_cl_linear_constraint()
+        if self.cl_linear_constraint != NULL:
+            _constraints_by_addr[get_P_Constraint_addr(self.cl_linear_constraint)] = self
 
     def __dealloc__(self):
         delete_P_Constraint(self.cl_linear_constraint)
@@ -615,6 +712,9 @@ cdef class LinearConstraint:
     def __str__(self):
         return '%s %s %s' % (self.lhs, self.op, self.rhs)
 
+    def __reduce__(self):
+        return (type(self), (self.lhs, self.rhs, self._strength, self._weight))
+
 
     property strength:
         def __get__(self):
@@ -725,6 +825,18 @@ cdef class EQConstraint(LinearConstraint):
         def __get__(self):
             return abs(self.rhs.value - self.lhs.value)
 
+cdef class EditHandles:
+    """ The edits of a sequence of variables, from Solver.edit_handles(),
+    for use with Solver.suggest_array().
+    """
+    cdef vector[ClEditHandle] handles
+    cdef readonly object solver
+    cdef readonly tuple variables
+
+    def __len__(self):
+        return self.handles.size()
+
+
 cdef class Solver:
     cdef ClSimplexSolver *solver
     cdef bint _autosolve
@@ -751,21 +863,476 @@ cdef class Solver:
             self._explaining = explaining
             self.solver.SetExplaining(explaining)
 
+    property minimal_explanations:
+        """ Whether the constraints an ExplainedCassowaryError (or
+        try_add_constraint()) gives for a required failure are cut down
+        to an irreducible conflict: the failing constraint and those
+        that cannot hold along with it, but can without any one of them.
+        This takes some trial adds when a constraint fails.
+        """
+        def __get__(self):
+            return self.solver.FIsMinimalExplanations()
+
+        def __set__(self, bint minimal):
+            self.solver.SetMinimalExplanations(minimal)
+
+    property writes_variables:
+        """ Whether solving sets the value of every ConstraintVariable, as
+        it does by default. With this off a solve costs nothing for the
+        variables it does not touch: read the ones wanted with value_of()
+        or set them with update_values(). Turning it back on sets them
+        all.
+        """
+        def __get__(self):
+            return self.solver.FWritesVariables()
+
+        def __set__(self, bint writes):
+            self.solver.SetWritesVariables(writes)
+
+    property solution_number:
+        """ A count that goes up whenever solving gives new values, so
+        that values read with value_of() can be kept until it changes.
+        """
+        def __get__(self):
+            return self.solver.SolutionNumber()
+
+    property tracks_satisfaction:
+        """ Whether the solver keeps track of which non-required
+        constraints are satisfied, for satisfaction_changes(). Cannot be
+        changed in a transaction.
+        """
+        def __get__(self):
+            return self.solver.FTracksSatisfaction()
+
+        def __set__(self, bint tracks):
+            self.solver.SetTracksSatisfaction(tracks)
+
+    property change_tolerance:
+        """ How far a ConstraintVariable's value must move from the value
+        changed_variables() last listed it with to be listed again; 0 (the
+        default) counts any change.
+        """
+        def __get__(self):
+            return self.solver.ChangeTolerance()
+
+        def __set__(self, double tolerance):
+            if tolerance < 0:
+                raise ValueError("The tolerance cannot be negative.")
+            self.solver.SetChangeTolerance(tolerance)
+
     def __dealloc__(self):
         del self.solver
 
     def __str__(self):
         return solver_str(self.solver).c_str()
 
+    def clone(self):
+        """ Return a new Solver in the same state as this one, to try
+        changes out on without disturbing this one.
+
+        The two share the tableau's rows until one of them changes one,
+        and nothing is solved again, but the rest of the solver's state
+        is copied, so this still takes time in proportion to the size of
+        the model. The new Solver does not set the ConstraintVariables,
+        which stay this one's: read its values with value_of(), or turn
+        its writes_variables on.
+
+        A solver in a transaction cannot be cloned, since rolling the
+        transaction back would change the clone too:
+
+        >>> solver = Solver()
+        >>> solver.begin_transaction()
+        >>> solver.clone()  # doctest: +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+            ...
+        CassowaryError: ExCLTransactionMisuse: Transaction protocol usage violation
+        """
+        cdef Solver other = Solver(self._autosolve, self._explaining)
+        del other.solver
+        other.solver = self.solver.Clone()
+        return other
+
+    def __reduce__(self):
+        cdef string data
+        cdef vector[ClVariable] externals
+        cdef vector[P_Constraint] cns
+        self.solver.Save(data, &externals, &cns)
+        return (_load_solver, (data, _variable_wrappers(externals), _constraint_wrappers(cns)))
+
+    def save(self, bytes path):
+        """ Save the whole state of the solver to the file at path, for
+        Solver.load().
+
+        Returns the ConstraintVariables the solver refers to, in the order
+        load() binds them in (None for any that is no longer alive).
+        """
+        cdef vector[ClVariable] externals
+        self.solver.SaveFile(path, &externals, NULL)
+        return _variable_wrappers(externals)
+
+    @staticmethod
+    def load(bytes path, variables=None):
+        """ Load a Solver saved by save() from the file at path, and
+        return it along with its ConstraintVariables.
+
+        The file is mapped into memory and read in place; nothing is
+        re-solved. The ConstraintVariables given in variables, as save()
+        returned them, stand in for the saved ones and take their saved
+        values; the others are made anew. The constraints are all new,
+        and only live inside the Solver.
+        """
+        return _load(path, variables, None, True)
+
+    def read_model(self, bytes text, variables=None):
+        """ Add the constraints, stays and edit variables of a model
+        written as text ( see cassowary/Reader.h for the syntax).
+
+        variables maps names to ConstraintVariables the model can use
+        without declaring them. Returns a dict of all the model's
+        ConstraintVariables by name, and the number of required
+        constraints that could not be satisfied and were left out.
+        Errors in the text raise a CassowaryError giving the line and
+        column. The GIL is released while the model is read.
+        """
+        return _read_model(self, text, False, variables)
+
+    def read_model_file(self, bytes path, variables=None):
+        """ Like read_model(), for the model in the file at path, which
+        is read a chunk at a time.
+        """
+        return _read_model(self, path, True, variables)
+
+    def export(self, bytes format=b'lp'):
+        """ Return the solver as text for other tools to read.
+
+        With format b'lp' or b'mps', this is the linear program the
+        constraints make, in CPLEX LP or free MPS format: the required
+        constraints are hard, and the errors in the others are minimized,
+        weighted by strength times weight. With b'mtx' it is the current
+        tableau as a MatrixMarket matrix, one row per basic variable.
+        """
+        if format not in (b'lp', b'mps', b'mtx'):
+            raise ValueError('unknown export format %r' % (format,))
+        return export_solver(self.solver, format)
+
     def add_constraint(self, LinearConstraint constraint):
         self.solver.AddConstraint(deref(constraint.cl_linear_constraint))
 
+    def try_add_constraint(self, LinearConstraint constraint, list explanation=None):
+        """ Add a LinearConstraint if it can be satisfied, returning
+        whether it was added.
+
+        A required constraint that conflicts with those in the solver is
+        not added, and the solver is left as it was; nothing is raised.
+        If a list is given as explanation, the LinearConstraints that
+        conflict with it are appended to it. Other errors still raise
+        CassowaryError.
+        """
+        cdef vector[size_t] addrs
+        cdef int status
+        cdef size_t i
+        if explanation is None:
+            status = try_add_constraint(self.solver, deref(constraint.cl_linear_constraint), NULL)
+        else:
+            status = try_add_constraint(self.solver, deref(constraint.cl_linear_constraint), &addrs)
+            for i in range(addrs.size()):
+                cn = _constraints_by_addr.get(addrs[i])
+                if cn is not None:
+                    explanation.append(cn)
+        if status == clsOk:
+            return True
+        if status == clsRequiredFailure:
+            return False
+        raise CassowaryError(_status_messages[status])
+
+    def add_constraints(self, constraints):
+        """ Add a sequence of LinearConstraints, solving only once at the
+        end.
+
+        Required constraints that cannot be satisfied along with the rest
+        are left out, and returned in a list. They are the same ones that
+        adding the constraints one at a time, in order, would reject:
+
+        >>> x = ConstraintVariable(b'x')
+        >>> solver = Solver(autosolve=True)
+        >>> solver.add_constraint(x >= 0)
+        >>> too_small = x <= 3
+        >>> solver.add_constraints([x >= 5, too_small]) == [too_small]
+        True
+        >>> x.value
+        5.0
+
+        The GIL is released while the solver works.
+        """
+        cdef vector[P_Constraint] cns
+        cdef vector[P_Constraint] failed
+        cdef LinearConstraint constraint
+        cdef size_t i
+        constraints = list(constraints)
+        for constraint in constraints:
+            cns.push_back(deref(constraint.cl_linear_constraint))
+        with nogil:
+            self.solver.AddConstraints(cns, &failed)
+        if failed.size() == 0:
+            return []
+        failed_addrs = set()
+        for i in range(failed.size()):
+            failed_addrs.add(get_P_Constraint_addr(&failed[i]))
+        return [constraint for constraint in constraints
+            if get_P_Constraint_addr(constraint.cl_linear_constraint) in failed_addrs]
+
     def remove_constraint(self, LinearConstraint constraint):
         self.solver.RemoveConstraint(deref(constraint.cl_linear_constraint))
 
+    def try_remove_constraint(self, LinearConstraint constraint):
+        """ Remove a LinearConstraint, returning False instead of raising
+        if it is not in the solver.
+        """
+        cdef ClStatus status
+        status = self.solver.TryRemoveConstraint(deref(constraint.cl_linear_constraint))
+        if status == clsOk:
+            return True
+        if status == clsConstraintNotFound:
+            return False
+        raise CassowaryError(_status_messages[status])
+
+    def remove_constraints(self, constraints):
+        """ Remove a sequence of LinearConstraints, solving only once at
+        the end.
+        """
+        cdef vector[P_Constraint] cns
+        cdef LinearConstraint constraint
+        for constraint in constraints:
+            cns.push_back(deref(constraint.cl_linear_constraint))
+        self.solver.RemoveConstraints(cns)
+
+    def reconcile(self, constraints):
+        """ Make the constraints in the solver be exactly the given
+        LinearConstraints.
+
+        Constraints that say the same thing as ones already in the solver
+        are matched up with them, so only the differences are removed and
+        added, with a single re-solve at the end. On error the solver is
+        left as it was.
+        """
+        cdef vector[P_Constraint] desired
+        cdef LinearConstraint constraint
+        for constraint in constraints:
+            desired.push_back(deref(constraint.cl_linear_constraint))
+        self.solver.Reconcile(desired)
+
+    def begin_transaction(self):
+        """ Start a transaction: the changes made to the solver until the
+        matching commit() or rollback() can be undone exactly by
+        rollback(). Constraints can be added and removed in a
+        transaction, but edits, groups and strength changes raise an
+        error. Transactions nest.
+        """
+        self.solver.BeginTransaction()
+
+    def commit(self):
+        """ Keep the changes made since the matching begin_transaction().
+        """
+        self.solver.CommitTransaction()
+
+    def rollback(self):
+        """ Undo the changes made since the matching begin_transaction(),
+        variable values included.
+        """
+        self.solver.RollbackTransaction()
+
+    property in_transaction:
+        def __get__(self):
+            return self.solver.FInTransaction()
+
+    def transaction(self):
+        """ Return a context manager that runs its block in a transaction,
+        committed if the block finishes and rolled back if it raises.
+        """
+        return SolverTransactionContext(self)
+
+    def add_edit_slot(self, ConstraintVariable variable):
+        """ Keep an edit constraint for the variable in the solver between
+        edits, so that suggest_values() on it only changes a weight
+        instead of adding and removing a constraint each time.
+        """
+        self.solver.AddEditSlot(deref(variable.variable))
+
+    def remove_edit_slot(self, ConstraintVariable variable):
+        """ Drop the edit slot added by add_edit_slot().
+        """
+        self.solver.RemoveEditSlot(deref(variable.variable))
+
     def suggest_values(self, var_vals, Strength default_strength=strong, double default_weight=1.0):
         return SolverEditContext(self, var_vals, default_strength, default_weight)
 
+    def edit_handles(self, variables):
+        """ Return the EditHandles of the given variables, which must be
+        being edited (e.g. inside a suggest_values() block).
+        """
+        cdef EditHandles handles = EditHandles()
+        cdef ConstraintVariable variable
+        handles.solver = self
+        handles.variables = tuple(variables)
+        for variable in handles.variables:
+            handles.handles.push_back(self.solver.EditHandleFor(deref(variable.variable)))
+        return handles
+
+    def suggest_array(self, EditHandles handles, double[::1] values):
+        """ Suggest values[i] for the i-th variable of the EditHandles and
+        re-solve, all in one call.
+
+        values may be anything exposing a contiguous buffer of doubles,
+        such as a float64 NumPy array.
+        """
+        if handles.solver is not self:
+            raise ValueError("The EditHandles belong to another Solver.")
+        if <size_t>values.shape[0] != handles.handles.size():
+            msg = "Expected {} values, got {}.".format(handles.handles.size(), values.shape[0])
+            raise ValueError(msg)
+        if values.shape[0] == 0:
+            self.solver.Resolve()
+            return
+        self.solver.SuggestValues(&handles.handles[0], &values[0], values.shape[0])
+
+    def solve_scenarios(self, scenarios, variables, int threads=0):
+        """ Solve several variants of the model at once and return the
+        values of the given ConstraintVariables in each, as a 2-D array of
+        doubles with a row per scenario (numpy.asarray() views it as a
+        NumPy array).
+
+        Each scenario is a sequence of LinearConstraints to add and
+        (variable, value) pairs to suggest for variables being edited
+        (e.g. inside a suggest_values() block). Each is solved on a copy
+        of the solver, so neither it nor the variables change. A scenario
+        whose required constraints cannot all be satisfied gets a row of
+        NaNs. The GIL is released while they are solved, on up to
+        `threads` threads (0 means one per processor).
+        """
+        cdef vector[ClScenario] cl_scenarios
+        cdef vector[ClVariable] cl_vars
+        cdef ConstraintVariable variable
+        cdef LinearConstraint constraint
+        cdef double value
+        cdef double[:, ::1] values
+        cdef size_t i
+        scenarios = list(scenarios)
+        for variable in variables:
+            cl_vars.push_back(deref(variable.variable))
+        if len(scenarios) == 0 or cl_vars.size() == 0:
+            # (a cython.view.array cannot be empty, but a slice of one can)
+            values = cvarray(shape=(1, 1), itemsize=sizeof(double), format="d")
+            return values[:len(scenarios), :cl_vars.size()]
+        cl_scenarios.resize(len(scenarios))
+        for i in range(len(scenarios)):
+            for item in scenarios[i]:
+                if isinstance(item, LinearConstraint):
+                    constraint = item
+                    cl_scenarios[i]._constraints.push_back(deref(constraint.cl_linear_constraint))
+                else:
+                    variable, value = item
+                    cl_scenarios[i]._editVars.push_back(deref(variable.variable))
+                    cl_scenarios[i]._editValues.push_back(value)
+        result = cvarray(shape=(len(scenarios), cl_vars.size()), itemsize=sizeof(double), format="d")
+        values = result
+        with nogil:
+            self.solver.SolveScenarios(cl_scenarios, cl_vars, &values[0, 0], threads)
+        return result
+
+    def snap_to_grid(self, variables, double grid=1.0, int max_trials=256):
+        """ Set the given ConstraintVariables to multiples of grid (whole
+        device pixels, say) as far as the required constraints allow, and
+        the others to the best solution given those values. Returns the
+        number of them snapped.
+
+        The solver tries each variable at the nearer multiple, then the
+        other, backtracking to snap as many as it can, with at most
+        max_trials trial constraints in all. Only the values change, as
+        written to the variables (or, if the solver does not write them,
+        as value_of() gives them): the next solve (e.g. at the next
+        suggest_values()) starts from the unsnapped solution again.
+        """
+        cdef vector[ClVariable] cl_vars
+        cdef ConstraintVariable variable
+        if grid <= 0:
+            raise ValueError("The grid must be positive.")
+        for variable in variables:
+            cl_vars.push_back(deref(variable.variable))
+        return self.solver.SnapToGrid(cl_vars, grid, max_trials)
+
+    def changed_variables(self):
+        """ Return an array of the ConstraintVariables whose values the
+        last solve changed (by more than change_tolerance from the value
+        each was last reported with), so that only what depends on them
+        need be redrawn. This works whether or not the solver writes the
+        variables. Variables snap_to_grid() set since then are included
+        too.
+        """
+        cdef vector[ClVariable] changed = self.solver.ChangedVariables()
+        cdef object[::1] result
+        cdef Py_ssize_t i
+        wrappers = [v for v in _variable_wrappers(changed) if v is not None]
+        # (a cython.view.array cannot be empty, but a slice of one can)
+        result = cvarray(shape=(max(len(wrappers), 1),), itemsize=sizeof(void *), format="O")
+        for i in range(len(wrappers)):
+            result[i] = wrappers[i]
+        return result[:len(wrappers)]
+
+    def satisfaction_changes(self):
+        """ Return a list of (LinearConstraint, satisfied) pairs for the
+        non-required constraints whose satisfaction the last solve
+        changed, with whether each is now satisfied. This needs
+        tracks_satisfaction on; the solver then checks only the
+        constraints the solve touched, rather than all of them.
+        """
+        cdef vector[pair[P_Constraint, cppbool]] changes = self.solver.SatisfactionChanges()
+        cdef size_t i
+        result = []
+        for i in range(changes.size()):
+            cn = _constraints_by_addr.get(get_P_Constraint_addr(&changes[i].first))
+            if cn is not None:
+                result.append((cn, changes[i].second))
+        return result
+
+    def constraint_errors(self, constraints, bint weighted=False):
+        """ Return the errors of a sequence of LinearConstraints at the
+        values last solved for, as an array of doubles (numpy.asarray()
+        views it as a NumPy array): what their .error properties give,
+        all worked out at once in C++.
+
+        With weighted, each error is multiplied by its constraint's
+        strength (flattened to a number, as export() does) and weight.
+        """
+        cdef vector[P_Constraint] cns
+        cdef LinearConstraint constraint
+        cdef double[::1] errors
+        for constraint in constraints:
+            cns.push_back(deref(constraint.cl_linear_constraint))
+        if cns.size() == 0:
+            # (a cython.view.array cannot be empty, but a slice of one can)
+            errors = cvarray(shape=(1,), itemsize=sizeof(double), format="d")
+            return errors[:0]
+        result = cvarray(shape=(cns.size(),), itemsize=sizeof(double), format="d")
+        errors = result
+        self.solver.ConstraintErrors(cns, &errors[0], weighted)
+        return result
+
+    def value_of(self, ConstraintVariable variable):
+        """ The value of a ConstraintVariable as last solved for, whether
+        or not it was set (see writes_variables).
+        """
+        return self.solver.ValueOf(deref(variable.variable))
+
+    def update_values(self, variables):
+        """ Set the given ConstraintVariables to their values as last
+        solved for, even when the solver does not write variables.
+        """
+        cdef vector[ClVariable] cl_vars
+        cdef ConstraintVariable variable
+        for variable in variables:
+            cl_vars.push_back(deref(variable.variable))
+        self.solver.UpdateValues(cl_vars)
+
     cdef object _begin_edit_suggest_values(self, var_vals, Strength default_strength=strong, double default_weight=1.0):
         cdef ConstraintVariable variable
         cdef double value
@@ -801,6 +1368,115 @@ cdef class Solver:
         self.solver.EndEdit()
 
 
+cdef ConstraintVariable _wrap_variable(ClVariable v):
+    """ Return a new ConstraintVariable for the C++ variable v.
+    """
+    cdef ConstraintVariable variable = ConstraintVariable(v.Name(), v.Value())
+    del _variables_by_addr[get_Variable_addr(deref(variable.variable))]
+    del variable.variable
+    variable.variable = new ClVariable(v)
+    _variables_by_addr[get_Variable_addr(v)] = variable
+    return variable
+
+cdef list _variable_wrappers(vector[ClVariable] &variables):
+    cdef size_t i
+    return [_variables_by_addr.get(get_Variable_addr(variables[i]))
+        for i in range(variables.size())]
+
+cdef list _constraint_wrappers(vector[P_Constraint] &cns):
+    cdef size_t i
+    return [_constraints_by_addr.get(get_P_Constraint_addr(&cns[i]))
+        for i in range(cns.size())]
+
+cdef object _load(bytes source, variables, constraints, bint from_file):
+    """ Load a Solver saved in source, or in the file it names, binding
+    the given ConstraintVariables and LinearConstraints (None for those to
+    make anew), and return it along with its ConstraintVariables.
+    """
+    cdef vector[ClVariable] bind_vars
+    cdef vector[P_Constraint] bind_cns
+    cdef vector[ClVariable] externals
+    cdef ConstraintVariable variable
+    cdef LinearConstraint constraint
+    cdef ClSimplexSolver *cl_solver
+    cdef Solver solver
+    cdef size_t i
+    variables = list(variables or ())
+    for variable in variables:
+        if variable is None:
+            bind_vars.push_back(clvNil)
+        else:
+            bind_vars.push_back(deref(variable.variable))
+    for constraint in constraints or ():
+        if constraint is None:
+            bind_cns.push_back(NULL)
+        else:
+            bind_cns.push_back(deref(constraint.cl_linear_constraint))
+    if from_file:
+        cl_solver = load_solver_file(source, &bind_vars, &bind_cns, &externals, NULL)
+    else:
+        cl_solver = load_solver(source, &bind_vars, &bind_cns, &externals, NULL)
+    solver = Solver()
+    del solver.solver
+    solver.solver = cl_solver
+    solver._autosolve = cl_solver.FIsAutosolving()
+    solver._explaining = cl_solver.FIsExplaining()
+    result = []
+    for i in range(externals.size()):
+        if i < len(variables) and variables[i] is not None:
+            result.append(variables[i])
+        else:
+            result.append(_wrap_variable(externals[i]))
+    return solver, result
+
+cdef object _read_model(Solver solver, bytes source, bint from_file, variables):
+    cdef vector[string] names
+    cdef vector[ClVariable] vars
+    cdef vector[P_Constraint] failed
+    cdef ConstraintVariable variable
+    cdef size_t i
+    cdef bint fFile = from_file
+    cdef string cpp_source = source
+    variables = dict(variables or {})
+    for name, variable in variables.items():
+        names.push_back(name)
+        vars.push_back(deref(variable.variable))
+    with nogil:
+        read_model(solver.solver, cpp_source, fFile, &names, &vars, &failed)
+    result = {}
+    for i in range(names.size()):
+        name = names[i]
+        variable = _variables_by_addr.get(get_Variable_addr(vars[i]))
+        if variable is None:
+            variable = _wrap_variable(vars[i])
+        result[name] = variable
+    return result, failed.size()
+
+def _load_solver(bytes data, variables, constraints):
+    """ Unpickle a Solver.
+    """
+    return _load(data, variables, constraints, False)[0]
+
+
+cdef class SolverTransactionContext:
+    """ Context manager for a transaction on a solver.
+    """
+    cdef public Solver solver
+
+    def __cinit__(self, solver):
+        self.solver = solver
+
+    def __enter__(self):
+        self.solver.begin_transaction()
+        return self.solver
+
+    def __exit__(self, exc_type, exc_val, exc_tb):
+        if exc_type is None:
+            self.solver.commit()
+        else:
+            self.solver.rollback()
+
+
 cdef class SolverEditContext:
     """ Context manager for suggesting variables in a solver.
     """
@@ -7,12 +7,17 @@
 #include "cassowary/LinearEquation.h"
 #include "cassowary/LinearInequality.h"
 #include "cassowary/Errors.h"
+#include "cassowary/Reader.h"
 
 
 size_t get_P_Constraint_addr(P_Constraint *pcn) {
     return reinterpret_cast<size_t>(pcn->ptr());
 }
 
+size_t get_Variable_addr(const Variable &v) {
+    return reinterpret_cast<size_t>(v.get_pclv());
+}
+
 std::vector<size_t> get_cpp_exception_constraint_pointers() {
     std::vector<size_t> constraint_pointers;
     try {
@@ -49,6 +54,19 @@ std::string solver_str(SimplexSolver *solver) {
     return ss.str();
 }
 
+int try_add_constraint(SimplexSolver *solver, const P_Constraint &cn, std::vector<size_t> *explanation) {
+    if (explanation == NULL) {
+        return solver->TryAddConstraint(cn);
+    }
+    ConstraintSet cset;
+    ClStatus status = solver->TryAddConstraint(cn, &cset);
+    ConstraintSet::const_iterator it = cset.begin();
+    for (; it != cset.end(); ++it) {
+        explanation->push_back(reinterpret_cast<size_t>((*it).ptr()));
+    }
+    return status;
+}
+
 
 P_Constraint *newLinearEquation(const P_LinearExpression &lhs, const P_LinearExpression &rhs, const Strength &strength, double weight) {
     P_Constraint result(new LinearEquation(lhs, rhs, strength, weight));
@@ -65,3 +83,40 @@ P_LinearExpression newLinearExpression(double constant) {
 void delete_P_Constraint(P_Constraint *pcn) {
     delete pcn;
 }
+
+SimplexSolver *load_solver(const std::string &bytes, const std::vector<Variable> *bindVars, const std::vector<P_Constraint> *bindCns, std::vector<Variable> *externals, std::vector<P_Constraint> *cns) {
+    return SimplexSolver::Load(bytes.data(), bytes.size(), bindVars, bindCns, externals, cns);
+}
+
+SimplexSolver *load_solver_file(const std::string &path, const std::vector<Variable> *bindVars, const std::vector<P_Constraint> *bindCns, std::vector<Variable> *externals, std::vector<P_Constraint> *cns) {
+    return SimplexSolver::LoadFile(path.c_str(), bindVars, bindCns, externals, cns);
+}
+
+void read_model(SimplexSolver *solver, const std::string &source, bool fFile, std::vector<std::string> *names, std::vector<Variable> *vars, std::vector<P_Constraint> *failed) {
+    StringToVarMap map;
+    for (size_t i = 0; i < names->size(); ++i)
+        map.insert(StringToVarMap::value_type((*names)[i], (*vars)[i]));
+    ModelReader reader(*solver, map);
+    if (fFile)
+        reader.ReadFile(source.c_str());
+    else
+        reader.Feed(source).Finish();
+    *failed = reader.FailedConstraints();
+    names->clear();
+    vars->clear();
+    for (StringToVarMap::iterator it = map.begin(); it != map.end(); ++it) {
+        names->push_back(it->first);
+        vars->push_back(it->second);
+    }
+}
+
+std::string export_solver(SimplexSolver *solver, const std::string &format) {
+    std::ostringstream xo;
+    if (format == "lp")
+        solver->WriteLP(xo);
+    else if (format == "mps")
+        solver->WriteMPS(xo);
+    else
+        solver->WriteTableau(xo);
+    return xo.str();
+}
@@ -8,8 +8,14 @@
 std::vector<size_t> get_cpp_exception_constraint_pointers();
 std::string get_cpp_exception_message();
 std::string solver_str(SimplexSolver *solver);
+int try_add_constraint(SimplexSolver *solver, const P_Constraint &cn, std::vector<size_t> *explanation);
 P_Constraint *newLinearEquation(const P_LinearExpression &lhs, const P_LinearExpression &rhs, const Strength &strength, double weight);
 P_Constraint *newLinearInequality(const P_LinearExpression &lhs, CnRelation op, const P_LinearExpression &rhs, const Strength &strength, double weight);
 P_LinearExpression newLinearExpression(double constant);
 void delete_P_Constraint(P_Constraint *pcn);
 size_t get_P_Constraint_addr(P_Constraint *pcn);
+size_t get_Variable_addr(const Variable &v);
+SimplexSolver *load_solver(const std::string &bytes, const std::vector<Variable> *bindVars, const std::vector<P_Constraint> *bindCns, std::vector<Variable> *externals, std::vector<P_Constraint> *cns);
+SimplexSolver *load_solver_file(const std::string &path, const std::vector<Variable> *bindVars, const std::vector<P_Constraint> *bindCns, std::vector<Variable> *externals, std::vector<P_Constraint> *cns);
+void read_model(SimplexSolver *solver, const std::string &source, bool fFile, std::vector<std::string> *names, std::vector<Variable> *vars, std::vector<P_Constraint> *failed);
+std::string export_solver(SimplexSolver *solver, const std::string &format);
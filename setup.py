@@ -32,6 +32,7 @@ cysw_module = Extension(
         'cassowary/FDVariable.cc',
         'cassowary/FloatVariable.cc',
         'cassowary/LinearExpression.cc',
+        'cassowary/Reader.cc',
         'cassowary/SimplexSolver.cc',
         'cassowary/SlackVariable.cc',
         'cassowary/Solver.cc',